@@ -0,0 +1,64 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HFM_ADAPTIVECODER_HPP
+#define HFM_ADAPTIVECODER_HPP
+
+#include <AdaptiveModel.hpp>
+#include <cstdint>
+
+namespace hfm {
+
+// One pass coder for streams of unknown length. Codes adapt to the data as
+// it arrives and no header is written, so output starts with the first
+// symbol. Whole bytes are written as soon as they are complete.
+class AdaptiveCoder {
+public:
+    AdaptiveCoder();
+    AdaptiveCoder(const AdaptiveCoder& other) = delete; // Non-copyable
+    AdaptiveCoder(AdaptiveCoder&& other) noexcept = default;
+    ~AdaptiveCoder() = default;
+    void reset();
+    // Codes size bytes into outBuff, which must hold getMaxOutput(size)
+    // bytes. Returns the number of bytes written. Up to 7 bits stay pending
+    // until more input arrives or the stream is flushed.
+    std::uint64_t compress(const char* inBuff, std::uint64_t size,
+                           char* outBuff);
+    // Pads the output to a byte boundary so the decoder can return every
+    // byte given so far. outBuff must hold getMaxOutput(0) bytes.
+    std::uint64_t flush(char* outBuff);
+    // Ends the stream. outBuff must hold getMaxOutput(0) bytes.
+    std::uint64_t finish(char* outBuff);
+
+    static std::uint64_t getMaxOutput(std::uint64_t size);
+
+    AdaptiveCoder& operator=(const AdaptiveCoder& other) = delete;
+    AdaptiveCoder& operator=(AdaptiveCoder&& other) noexcept = default;
+
+private:
+    std::uint64_t writeSymbol(int symbol, char* outBuff);
+    std::uint64_t padToByte(char* outBuff);
+
+private:
+    AdaptiveModel m_model;
+    bool m_finished;
+
+    // Compression state
+    std::uint64_t m_acc;    // Accumulator for codes
+    unsigned int m_accUsed; // Bits in the accumulator not yet written
+};
+
+}
+
+#endif //! HFM_ADAPTIVECODER_HPP
@@ -0,0 +1,55 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HFM_ADAPTIVEDECODER_HPP
+#define HFM_ADAPTIVEDECODER_HPP
+
+#include <AdaptiveModel.hpp>
+#include <cstdint>
+
+namespace hfm {
+
+// Decoder for streams written by AdaptiveCoder. Input can be given in pieces
+// of any size; a code split between two pieces is completed by the next one.
+class AdaptiveDecoder {
+public:
+    AdaptiveDecoder();
+    AdaptiveDecoder(const AdaptiveDecoder& other) = delete; // Non-copyable
+    AdaptiveDecoder(AdaptiveDecoder&& other) noexcept = default;
+    ~AdaptiveDecoder() = default;
+    void reset();
+    // Decodes size bytes of the stream into outBuff, which must hold
+    // getMaxOutput(size) bytes. Returns the number of bytes written. Input
+    // after the end of the stream is ignored.
+    std::uint64_t decompress(const char* inBuff, std::uint64_t size,
+                             char* outBuff);
+    bool isFinished() const;
+
+    static std::uint64_t getMaxOutput(std::uint64_t size);
+
+    AdaptiveDecoder& operator=(const AdaptiveDecoder& other) = delete;
+    AdaptiveDecoder& operator=(AdaptiveDecoder&& other) noexcept = default;
+
+private:
+    AdaptiveModel m_model;
+    bool m_finished;
+
+    // Decompression state
+    std::uint64_t m_code;     // Bits of the code read so far
+    unsigned int m_codeUsed;  // Number of bits in m_code
+};
+
+}
+
+#endif //! HFM_ADAPTIVEDECODER_HPP
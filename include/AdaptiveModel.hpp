@@ -0,0 +1,66 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HFM_ADAPTIVEMODEL_HPP
+#define HFM_ADAPTIVEMODEL_HPP
+
+#include <CodeBuilder.hpp>
+#include <cstdint>
+
+namespace hfm {
+
+// Symbol statistics shared by the adaptive coder and decoder. Both sides
+// update the model with every coded symbol and rebuild the canonical codes
+// at the same points, so the decoder always knows the coder's current codes
+// without any header. Rebuilds start frequent and back off as the
+// statistics settle; counts are halved from time to time so the codes keep
+// following the data.
+class AdaptiveModel {
+public:
+    static constexpr int BYTE_SYMBOLS      = 256;
+    static constexpr int FLUSH             = 256; // Pad to a byte boundary
+    static constexpr int END               = 257; // End of the stream
+    static constexpr int SYMBOLS           = 258;
+    static constexpr unsigned int MAX_BITS = 32; // Longest code
+
+public:
+    AdaptiveModel();
+    void reset();
+    const Code& getCode(int symbol) const;
+    // Returns the symbol with the given code, -1 if the code is only a prefix
+    int findSymbol(std::uint64_t code, unsigned int length) const;
+    void update(int symbol);
+
+private:
+    void rebuild();
+
+private:
+    std::uint64_t m_counts[SYMBOLS];
+    std::uint64_t m_total;
+    unsigned int m_interval;     // Symbols between two rebuilds
+    unsigned int m_sinceRebuild; // Symbols since the last rebuild
+    Code m_codes[SYMBOLS];
+    CodeBuilder m_builder;
+
+    // Canonical decoding: codes of one length are consecutive, starting at
+    // m_firstCode, and belong to m_sorted[m_offsets] onwards
+    std::uint64_t m_firstCode[MAX_BITS + 1];
+    unsigned int m_lengthCounts[MAX_BITS + 1];
+    unsigned int m_offsets[MAX_BITS + 1];
+    int m_sorted[SYMBOLS];
+};
+
+}
+
+#endif //! HFM_ADAPTIVEMODEL_HPP
@@ -0,0 +1,66 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HFM_ARCHIVEFORMAT_HPP
+#define HFM_ARCHIVEFORMAT_HPP
+
+#include <cstdint>
+#include <cstring>
+
+namespace hfm {
+
+// Layout of a multi-file archive. All fields are little endian.
+//
+//   header:    magic (8 bytes), version (u8), flags (u8), and with the
+//              SHARED_TABLE flag the shared code lengths: symbol count
+//              (u16), then for every symbol its value (u8) and length (u8)
+//   members:   the compressed data of every member, back to back
+//   directory: for every member its name length (u16), name (UTF-8),
+//              method (u8), original size (u64), compressed size (u64),
+//              offset of the data (u64) and CRC32C of the original (u32)
+//   trailer:   directory offset (u64), directory size (u64), member count
+//              (u32), END_MAGIC (4 bytes)
+//
+// The trailer has a fixed size, so a reader finds the directory from the end
+// of the file and can get to any member without reading the others.
+class ArchiveFormat {
+public:
+    enum Method : std::uint8_t {
+        STORED = 0, // Data is the original member
+        BLOCKS = 1, // Data is a block container (see BlockFormat)
+        SHARED = 2  // Data is a HuffmanCoder stream with the shared codes
+    };
+
+    enum Flags : std::uint8_t {
+        SHARED_TABLE = 1 << 0 // The header holds shared code lengths
+    };
+
+    static constexpr char MAGIC[8] = {'\x89', 'H',    'F',    'A',
+                                      '\r',   '\n',   '\x1a', '\n'};
+    static constexpr char END_MAGIC[4]             = {'H', 'F', 'A', 'D'};
+    static constexpr std::uint8_t VERSION          = 1;
+    static constexpr std::uint64_t HEADER_SIZE     = 8 + 1 + 1;
+    static constexpr std::uint64_t ENTRY_SIZE      = 2 + 1 + 8 + 8 + 8 + 4;
+    static constexpr std::uint64_t TRAILER_SIZE    = 8 + 8 + 4 + 4;
+
+public:
+    static bool isArchive(const char* buff, std::uint64_t buffSize) {
+        return buffSize >= HEADER_SIZE + TRAILER_SIZE &&
+               std::memcmp(buff, MAGIC, sizeof(MAGIC)) == 0;
+    }
+};
+
+}
+
+#endif //! HFM_ARCHIVEFORMAT_HPP
@@ -0,0 +1,101 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HFM_ARCHIVEREADER_HPP
+#define HFM_ARCHIVEREADER_HPP
+
+#include <ArchiveFormat.hpp>
+#include <HuffmanDecoder.hpp>
+#include <Kernels.hpp>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+namespace hfm {
+
+// Reads an archive written by ArchiveWriter from memory. Only the header
+// and the directory are read up front; members are decoded on request, in
+// any order and from any number of threads.
+class ArchiveReader {
+public:
+    struct Member {
+        std::string name;
+        std::uint8_t method;
+        std::uint64_t originalSize;
+        std::uint64_t compressedSize;
+        std::uint64_t offset; // Offset of the data in the archive
+        std::uint32_t checksum;
+    };
+
+public:
+    // Reads the directory, throwing std::runtime_error if it is damaged or
+    // names a member twice
+    ArchiveReader(const char* inBuff, std::uint64_t buffSize);
+    const std::vector<Member>& getMembers() const;
+    // Member with the given name, nullptr if there is none
+    const Member* findMember(const std::string& name) const;
+    // Compressed data of a member, member.compressedSize bytes
+    const char* getMemberData(const Member& member) const;
+    // Shared codes of all 256 bytes, nullptr if the archive has none
+    const Code* getSharedCodes() const;
+    // Decoder with the shared codes loaded, needed by extract(). Every
+    // thread needs its own.
+    HuffmanDecoder createDecoder() const;
+    // Writes member.originalSize bytes to outBuff and checks them
+    void extract(const Member& member, char* outBuff,
+                 HuffmanDecoder& decoder) const;
+    // Extracts every member below directory on the given number of threads
+    void extractAll(const std::filesystem::path& directory,
+                    unsigned int threads) const;
+    // Extracts every member on the given number of threads without keeping
+    // the output, checking sizes and checksums. Throws like extract() on
+    // the first damaged member and returns the total original size
+    // otherwise.
+    std::uint64_t verify(unsigned int threads) const;
+
+    // Path of a member below an output directory. Throws for names that
+    // would leave it (absolute paths or "..").
+    static std::filesystem::path getSafePath(const std::string& name);
+
+private:
+    // Extracts every member on the given number of threads and passes it
+    // to use, stopping at the first exception, which is rethrown
+    void extractEach(unsigned int threads,
+                     const std::function<void(const Member&, const char*)>&
+                         use) const;
+    void readHeader();
+    void readDirectory();
+    // Bound on the original size a member of its compressed size can have,
+    // checked before any buffer of that size is allocated
+    static std::uint64_t getMaxOriginalSize(const Member& member);
+
+private:
+    static constexpr int SYMBOLS = 256;
+
+    const char* m_inBuff;
+    std::uint64_t m_inBuffSize;
+    std::uint64_t m_dataStart; // End of the header
+    bool m_shared;
+    Code m_sharedCodes[SYMBOLS];
+    HuffmanDecoder::Dictionary m_sharedDictionary;
+    std::vector<Member> m_members;
+    std::unordered_map<std::string, std::size_t> m_index; // By name
+};
+
+}
+
+#endif //! HFM_ARCHIVEREADER_HPP
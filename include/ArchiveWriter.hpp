@@ -0,0 +1,117 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HFM_ARCHIVEWRITER_HPP
+#define HFM_ARCHIVEWRITER_HPP
+
+#include <ArchiveFormat.hpp>
+#include <ArchiveReader.hpp>
+#include <AsyncWriter.hpp>
+#include <BlockCoder.hpp>
+#include <Histogram.hpp>
+#include <HuffmanCoder.hpp>
+#include <Kernels.hpp>
+#include <ostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include <cstdint>
+
+namespace hfm {
+
+// Writes an archive (see ArchiveFormat) to a stream or a file, one member at
+// a time.
+// Every member is compressed on its own, as a block container or, after
+// setSharedTable(), with codes shared by all members, which saves a table
+// per member when there are many small ones.
+class ArchiveWriter {
+public:
+    // Larger members still get tables of their own, which pay for
+    // themselves at that size
+    static constexpr std::uint64_t SHARED_MAX_MEMBER = 1 << 16;
+
+public:
+    explicit ArchiveWriter(std::ostream& out);
+    // Writes through the file, which finish() also finishes
+    explicit ArchiveWriter(AsyncWriter& out);
+    ArchiveWriter(const ArchiveWriter& other) = delete; // Non-copyable
+    ~ArchiveWriter() = default;
+    // Builds the shared codes from the byte counts of the members it will
+    // be used for (those up to SHARED_MAX_MEMBER bytes). Must be called
+    // before the first member is added.
+    void setSharedTable(const std::uint64_t* frequencies);
+    // The same with counts merged from many parts, used for members up to
+    // maxMember bytes. Parts coded on their own with the codes of the same
+    // histogram can be added with copyMember().
+    void setSharedTable(const Histogram& histogram,
+                        std::uint64_t maxMember = SHARED_MAX_MEMBER);
+    // Shares the given canonical codes, for example those of an archive
+    // being copied (see ArchiveReader::getSharedCodes)
+    void setSharedCodes(const Code* codes,
+                        std::uint64_t maxMember = SHARED_MAX_MEMBER);
+    // Throws std::invalid_argument for a name that is empty, too long or
+    // already taken by another member
+    void addMember(const std::string& name, const char* data,
+                   std::uint64_t size);
+    // Adds a member of another archive as it is, without coding it again.
+    // Throws std::runtime_error for a member coded with shared codes other
+    // than the ones of this archive, or named like a member already added.
+    void copyMember(const ArchiveReader& reader,
+                    const ArchiveReader::Member& member);
+    // Writes the directory. No members can be added afterwards.
+    void finish();
+
+    ArchiveWriter& operator=(const ArchiveWriter& other) = delete;
+
+private:
+    struct Entry {
+        std::string name;
+        std::uint8_t method;
+        std::uint64_t originalSize;
+        std::uint64_t compressedSize;
+        std::uint64_t offset;
+        std::uint32_t checksum;
+    };
+
+    void write(const char* data, std::uint64_t size);
+    void writeHeader();
+    // The shared codes have a code for every byte of the data. Leaves the
+    // data and its byte counts in m_coder for compressShared().
+    bool isCovered(const char* data, std::uint64_t size);
+    // Return the size of the stream written to m_buffer, or 0 if it would
+    // not be smaller than size. compressShared() codes the size bytes last
+    // given to isCovered().
+    std::uint64_t compressBlocks(const char* data, std::uint64_t size);
+    std::uint64_t compressShared(std::uint64_t size);
+
+private:
+    static constexpr int SYMBOLS = 256;
+
+    std::ostream* m_stream; // Exactly one of m_stream and m_file is set
+    AsyncWriter* m_file;
+    std::vector<Entry> m_entries;
+    std::unordered_set<std::string> m_names; // Names of m_entries
+    bool m_headerWritten;
+    bool m_shared;          // Members are coded with m_codes
+    std::uint64_t m_sharedMaxMember; // Larger members get their own tables
+    Code m_codes[SYMBOLS];  // Shared codes, 0 length for unused bytes
+    HuffmanCoder m_coder;   // Coder with the shared codes loaded
+    BlockCoder m_blocks;    // Coder for members with their own tables
+    std::vector<char> m_buffer;
+    std::uint64_t m_offset; // Number of bytes written so far
+};
+
+}
+
+#endif //! HFM_ARCHIVEWRITER_HPP
@@ -0,0 +1,78 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HFM_ASYNCREADER_HPP
+#define HFM_ASYNCREADER_HPP
+
+#include <IoBackend.hpp>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <cstdint>
+
+namespace hfm {
+
+// Reads a file front to back through an IoBackend, keeping DEPTH - 1 reads
+// of BUFFER_SIZE bytes in flight ahead of the part being worked on, so the
+// disk is busy while the caller computes. Without a backend the file is
+// read with a plain stream.
+class AsyncReader {
+public:
+    static constexpr std::uint64_t BUFFER_SIZE = 1 << 20;
+    static constexpr unsigned int DEPTH        = 4;
+
+public:
+    explicit AsyncReader(const char* path);
+    // Reads through the given backend, which may be nullptr for a stream
+    AsyncReader(const char* path, std::unique_ptr<IoBackend> backend);
+    AsyncReader(const AsyncReader& other) = delete; // Non-copyable
+    ~AsyncReader();
+    std::uint64_t getSize() const;
+    // Next part of the file, at most BUFFER_SIZE bytes, which stays valid
+    // until the next call. Returns its size, 0 at the end of the file.
+    // Throws std::runtime_error if a read fails.
+    std::uint64_t next(const char*& data);
+
+    AsyncReader& operator=(const AsyncReader& other) = delete;
+
+private:
+    struct Slot {
+        std::uint64_t offset; // Offset of the part in the file
+        std::uint64_t size;   // Size of the part
+        std::uint64_t done;   // Bytes read so far
+        bool used;            // Holds a part that has not been returned
+    };
+
+    void submit(unsigned int slot);
+    void submitRest(unsigned int slot);
+    void waitFor(unsigned int slot);
+
+private:
+    std::string m_path;
+    std::unique_ptr<IoBackend> m_backend;
+    int m_fd;
+    bool m_direct;
+    std::uint64_t m_size;
+    char* m_buffers; // DEPTH buffers of BUFFER_SIZE bytes, aligned
+    Slot m_slots[DEPTH];
+    std::uint64_t m_nextOffset; // File offset of the next read
+    unsigned int m_inFlight;    // Reads not yet completed
+    unsigned int m_current;     // Slot returned by the next call
+    bool m_holding;             // The slot before m_current is in use
+    std::ifstream m_stream;     // Used when there is no backend
+};
+
+}
+
+#endif //! HFM_ASYNCREADER_HPP
@@ -0,0 +1,81 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HFM_ASYNCWRITER_HPP
+#define HFM_ASYNCWRITER_HPP
+
+#include <IoBackend.hpp>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <cstdint>
+
+namespace hfm {
+
+// Writes a file through an IoBackend. Data is gathered into buffers of
+// BUFFER_SIZE bytes, and full buffers are written behind the caller, with
+// up to DEPTH in flight and submitted in batches. Without a backend the
+// file is written with a plain stream.
+class AsyncWriter {
+public:
+    static constexpr std::uint64_t BUFFER_SIZE = 1 << 20;
+    static constexpr unsigned int DEPTH        = 4;
+
+public:
+    // The expected size decides whether O_DIRECT is used
+    explicit AsyncWriter(const char* path, std::uint64_t expectedSize = 0);
+    // Writes through the given backend, which may be nullptr for a stream
+    AsyncWriter(const char* path, std::uint64_t expectedSize,
+                std::unique_ptr<IoBackend> backend);
+    AsyncWriter(const AsyncWriter& other) = delete; // Non-copyable
+    // Finishes the file if finish() was not called, ignoring errors
+    ~AsyncWriter();
+    void write(const char* data, std::uint64_t size);
+    // Writes the rest and waits for every write to complete. Throws
+    // std::runtime_error if a write failed.
+    void finish();
+
+    AsyncWriter& operator=(const AsyncWriter& other) = delete;
+
+private:
+    struct Slot {
+        std::uint64_t offset; // Offset of the buffer in the file
+        std::uint64_t size;   // Bytes to write, padded with O_DIRECT
+        std::uint64_t done;   // Bytes written so far
+        bool busy;            // A write of the buffer is in flight
+    };
+
+    void submit(unsigned int slot);
+    void reap(); // Waits for one write
+    void fail(int error);
+
+private:
+    std::string m_path;
+    std::unique_ptr<IoBackend> m_backend;
+    int m_fd;
+    bool m_direct;
+    char* m_buffers; // DEPTH buffers of BUFFER_SIZE bytes, aligned
+    Slot m_slots[DEPTH];
+    unsigned int m_current;     // Buffer being filled
+    std::uint64_t m_fill;       // Bytes in the current buffer
+    std::uint64_t m_offset;     // File offset of the current buffer
+    unsigned int m_inFlight;    // Writes not yet completed
+    unsigned int m_unflushed;   // Writes submitted but not yet started
+    bool m_finished;
+    std::ofstream m_stream;     // Used when there is no backend
+};
+
+}
+
+#endif //! HFM_ASYNCWRITER_HPP
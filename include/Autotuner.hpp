@@ -0,0 +1,65 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HFM_AUTOTUNER_HPP
+#define HFM_AUTOTUNER_HPP
+
+#include <Profile.hpp>
+#include <ostream>
+#include <vector>
+#include <cstdint>
+
+namespace hfm {
+
+// Picks the Profile settings for this machine and this kind of data by
+// timing the candidates on a sample of the input. Among the candidates at
+// most SLOWDOWN slower than the fastest one, the one with the smallest
+// output wins, the faster one on a tie. Block sizes are measured first with
+// the sequential coder; thread counts and segment sizes are then measured
+// together on a JobPool, compressing and decompressing.
+class Autotuner {
+public:
+    // The sample is taken in SAMPLE_PARTS pieces spread over the input
+    static constexpr std::uint64_t MAX_SAMPLE = 16 << 20;
+    static constexpr int SAMPLE_PARTS         = 16;
+    static constexpr double SLOWDOWN          = 0.10;
+    static constexpr int RUNS                 = 2; // Best time of
+
+public:
+    // Every measurement is reported to log
+    explicit Autotuner(std::ostream& log);
+    Profile run(const char* data, std::uint64_t size);
+
+private:
+    struct Result {
+        double seconds;     // Compression and decompression
+        std::uint64_t size; // Compressed size
+    };
+
+    static std::vector<char> takeSample(const char* data, std::uint64_t size);
+    Result measureBlocks(const std::vector<char>& sample,
+                         std::uint64_t maxBlockSize);
+    Result measurePool(const std::vector<char>& sample, unsigned int threads,
+                       std::uint64_t segmentSize, std::uint64_t maxBlockSize);
+    void report(const std::vector<char>& sample, const Result& result);
+    // Index of the best result
+    static std::size_t pick(const std::vector<Result>& results);
+
+private:
+    std::ostream& m_log;
+};
+
+}
+
+#endif //! HFM_AUTOTUNER_HPP
@@ -0,0 +1,91 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HFM_BLOCKCODER_HPP
+#define HFM_BLOCKCODER_HPP
+
+#include <BlockFormat.hpp>
+#include <BlockSplitter.hpp>
+#include <HuffmanCoder.hpp>
+#include <RansCoder.hpp>
+#include <Transform.hpp>
+#include <vector>
+#include <cstdint>
+
+namespace hfm {
+
+// Writes the input as a block container (see BlockFormat), with a separate
+// code table for every block chosen by BlockSplitter. Every block is coded
+// with Huffman codes or rANS, whichever is expected to be smaller, after the
+// Transform that Transform::choose() picks for it, and blocks that would not
+// get smaller are stored as they are. Every block carries a CRC32C of its
+// data unless checksums are turned off.
+class BlockCoder {
+public:
+    // Output needed by one compress() call in the worst case
+    static constexpr std::uint64_t MAX_OUTPUT =
+        BlockFormat::HEADER_SIZE + BlockFormat::BLOCK_HEADER_SIZE +
+        BlockFormat::CHECKSUM_SIZE + BlockFormat::TRANSFORM_SIZE +
+        BlockFormat::MAX_BLOCK_SIZE +
+        HuffmanCoder::MAX_HEADER_SIZE + 8;
+
+public:
+    BlockCoder(const char* inBuff, std::uint64_t buffSize);
+    BlockCoder(const BlockCoder& other) = delete; // Non-copyable
+    BlockCoder(BlockCoder&& other) noexcept = default;
+    ~BlockCoder() = default;
+    void reset(const char* inBuff, std::uint64_t buffSize);
+    void setChecksum(bool enabled); // Enabled by default
+    // Upper bound on the size of a block, from BlockSplitter::SEGMENT_SIZE
+    // up to BlockFormat::MAX_BLOCK_SIZE (the default). Smaller blocks give
+    // decoders more parallel work. Throws std::invalid_argument otherwise.
+    void setMaxBlockSize(std::uint64_t size);
+    // Sizes of the blocks the input is split into
+    const std::vector<std::uint64_t>& getBlocks();
+    // Writes the next part of the container (one block per call) to outBuff,
+    // which must hold MAX_OUTPUT bytes. Returns the number of bytes written,
+    // or -1 once the container is complete.
+    std::int64_t compress(char* outBuff, std::uint64_t numBytes);
+
+    BlockCoder& operator=(const BlockCoder& other) = delete; // Non-copyable
+    BlockCoder& operator=(BlockCoder&& other) noexcept = default;
+
+private:
+    std::uint64_t writeBlock(char* outBuff, const char* block,
+                             std::uint64_t size);
+    // Returns the payload size, or 0 if it would not be smaller than size
+    std::uint64_t writeHuffman(char* payload, std::uint64_t size,
+                               HuffmanCoder& coder);
+
+private:
+    const char* m_inBuff;
+    std::uint64_t m_buffSize;
+    BlockSplitter m_splitter;
+    RansCoder m_rans;
+    std::vector<char> m_transformed; // Output of the block transform
+    std::vector<std::uint64_t> m_blocks;
+    bool m_blocksReady; // m_blocks describes the current input
+    bool m_checksum;    // Write a CRC32C with every block
+    std::uint64_t m_maxBlockSize;
+
+    // Compression state
+    bool m_headerWritten;
+    bool m_endWritten;
+    std::uint64_t m_nextBlock; // Index of the next block to write
+    std::uint64_t m_offset;    // Input offset of the next block
+};
+
+}
+
+#endif //! HFM_BLOCKCODER_HPP
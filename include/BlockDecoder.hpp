@@ -0,0 +1,90 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HFM_BLOCKDECODER_HPP
+#define HFM_BLOCKDECODER_HPP
+
+#include <BlockFormat.hpp>
+#include <HuffmanDecoder.hpp>
+#include <vector>
+#include <cstdint>
+
+namespace hfm {
+
+// Decoder for containers written by BlockCoder. The block list is read
+// first, so blocks can also be decoded independently with decodeBlock().
+class BlockDecoder {
+public:
+    struct Block {
+        std::uint8_t method;
+        std::uint8_t flags;
+        std::uint64_t originalSize;
+        std::uint64_t payloadSize;
+        std::uint64_t payloadOffset; // Offset of the payload in the input
+        std::uint64_t outputOffset;  // Offset of the data in the output
+        std::uint32_t checksum;      // CRC32C, if flags has CHECKSUM
+        std::uint8_t transform;      // Transform::Type of the payload data
+        std::uint64_t codedSize;     // Size of the data the payload codes
+    };
+
+public:
+    BlockDecoder(const char* inBuff, std::uint64_t buffSize);
+    BlockDecoder(const BlockDecoder& other) = delete; // Non-copyable
+    BlockDecoder(BlockDecoder&& other) noexcept = default;
+    ~BlockDecoder() = default;
+    void reset(const char* inBuff, std::uint64_t buffSize);
+    // Blocks of the container, checked against the input size
+    const std::vector<Block>& getBlocks();
+    std::uint64_t getOriginalSize();
+    // Writes the next block to outBuff, which must hold
+    // BlockFormat::MAX_BLOCK_SIZE bytes. Returns the number of bytes
+    // written, or -1 once every block has been decoded.
+    std::int64_t decompress(char* outBuff, std::uint64_t numBytes);
+    // Decodes every block on the given number of threads without keeping
+    // the output, checking sizes and checksums. Throws like decompress() on
+    // the first damaged block and returns the original size otherwise.
+    std::uint64_t verify(unsigned int threads);
+
+    // Writes block.originalSize bytes to outBuff, using the given decoder,
+    // and checks them against the block checksum if it has one
+    static void decodeBlock(const char* inBuff, const Block& block,
+                            char* outBuff, HuffmanDecoder& decoder);
+
+    BlockDecoder& operator=(const BlockDecoder& other) = delete; // Non-copyable
+    BlockDecoder& operator=(BlockDecoder&& other) noexcept = default;
+
+private:
+    void readBlocks();
+    // Decode the block.codedSize bytes of the payload to outBuff, with a
+    // fused checksum check if crc is set
+    static void decodeHuffman(const char* payload, const Block& block,
+                              char* outBuff, HuffmanDecoder& decoder,
+                              bool crc);
+    static void decodeRans(const char* payload, const Block& block,
+                           char* outBuff, bool crc);
+
+private:
+    const char* m_inBuff;
+    std::uint64_t m_inBuffSize;
+    std::vector<Block> m_blocks;
+    bool m_blocksRead;
+    std::uint64_t m_originalSize;
+
+    // Decompression state
+    std::uint64_t m_nextBlock; // Index of the next block to decode
+};
+
+}
+
+#endif //! HFM_BLOCKDECODER_HPP
@@ -0,0 +1,71 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HFM_BLOCKFORMAT_HPP
+#define HFM_BLOCKFORMAT_HPP
+
+#include <cstdint>
+#include <cstring>
+
+namespace hfm {
+
+// Layout of the block container. All fields are little endian.
+//
+//   container header: magic (8 bytes), version (u8), flags (u8)
+//   every block:      method (u8), flags (u8), original size (u32),
+//                     payload size (u32), CRC32C of the original data (u32,
+//                     only with the CHECKSUM flag), size of the transformed
+//                     data (u32, only with a transform), payload
+//   end of container: END (u8), flags (u8), total original size (u64)
+//
+// Every block is coded on its own, so blocks can be decoded in any order.
+// Bits 1-2 of the block flags hold the Transform applied before coding;
+// the payload then codes the transformed data.
+class BlockFormat {
+public:
+    enum Method : std::uint8_t {
+        STORED  = 0, // Payload is the original data
+        HUFFMAN = 1, // Payload is a HuffmanCoder stream
+        RANS    = 2, // Payload is a RansCoder stream
+        END     = 0xFF
+    };
+
+    enum BlockFlags : std::uint8_t {
+        CHECKSUM       = 1 << 0, // A CRC32C follows the block header
+        TRANSFORM_MASK = 3 << 1  // Transform::Type of the block
+    };
+
+    // Not a plausible original size of a plain HuffmanCoder stream, so both
+    // kinds of files can be told apart
+    static constexpr char MAGIC[8] = {'\x89', 'H',    'F',    'M',
+                                      '\r',   '\n',   '\x1a', '\n'};
+    static constexpr std::uint8_t VERSION            = 2; // 1 has no transforms
+    static constexpr std::uint64_t HEADER_SIZE       = 8 + 1 + 1;
+    static constexpr std::uint64_t BLOCK_HEADER_SIZE = 1 + 1 + 4 + 4;
+    static constexpr std::uint64_t CHECKSUM_SIZE     = 4;
+    static constexpr std::uint64_t TRANSFORM_SIZE    = 4;
+    static constexpr int TRANSFORM_SHIFT             = 1;
+    static constexpr std::uint64_t END_SIZE          = 1 + 1 + 8;
+    static constexpr std::uint64_t MAX_BLOCK_SIZE    = 1 << 20;
+
+public:
+    static bool isContainer(const char* buff, std::uint64_t buffSize) {
+        return buffSize >= HEADER_SIZE &&
+               std::memcmp(buff, MAGIC, sizeof(MAGIC)) == 0;
+    }
+};
+
+}
+
+#endif //! HFM_BLOCKFORMAT_HPP
@@ -0,0 +1,50 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HFM_BLOCKSPLITTER_HPP
+#define HFM_BLOCKSPLITTER_HPP
+
+#include <vector>
+#include <cstdint>
+
+namespace hfm {
+
+// Picks block boundaries where the byte distribution changes. The input is
+// cut into segments with one histogram each; a window of the following
+// segments is compared with the current block, and a new block starts only
+// if coding the window with its own table is estimated to save more bits
+// than the table costs. The boundary is then moved to the segment inside the
+// window where the split is cheapest.
+class BlockSplitter {
+public:
+    static constexpr std::uint64_t SEGMENT_SIZE = 4 << 10;
+    static constexpr int WINDOW_SEGMENTS        = 16;
+
+public:
+    // Returns the sizes of consecutive blocks covering the whole input, none
+    // larger than maxBlockSize, which must be at least SEGMENT_SIZE
+    std::vector<std::uint64_t> split(const char* data, std::uint64_t size,
+                                     std::uint64_t maxBlockSize);
+
+    // Estimated size in bits of data with the given byte histogram, coded
+    // with its own table, including the block and table headers
+    static double estimateBits(const std::uint64_t* histogram);
+
+private:
+    std::vector<std::uint64_t> m_segments; // 256 counts per segment
+};
+
+}
+
+#endif //! HFM_BLOCKSPLITTER_HPP
@@ -0,0 +1,108 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HFM_BYTEORDER_HPP
+#define HFM_BYTEORDER_HPP
+
+#include <cstdint>
+
+namespace hfm {
+
+// Fixed width little endian fields of the stream format, independent of the
+// byte order and integer sizes of the host
+
+inline void writeLE16(char* out, std::uint16_t value) {
+    out[0] = static_cast<char>(value & 0xFF);
+    out[1] = static_cast<char>((value >> 8) & 0xFF);
+}
+
+inline void writeLE32(char* out, std::uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[i] = static_cast<char>((value >> (i * 8)) & 0xFF);
+    }
+}
+
+inline void writeLE64(char* out, std::uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        out[i] = static_cast<char>((value >> (i * 8)) & 0xFF);
+    }
+}
+
+inline std::uint16_t readLE16(const char* in) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(in);
+    return static_cast<std::uint16_t>(p[0] | (p[1] << 8));
+}
+
+inline std::uint32_t readLE32(const char* in) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(in);
+    std::uint32_t value    = 0;
+    for (int i = 0; i < 4; i++) {
+        value |= static_cast<std::uint32_t>(p[i]) << (i * 8);
+    }
+
+    return value;
+}
+
+inline std::uint64_t readLE64(const char* in) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(in);
+    std::uint64_t value    = 0;
+    for (int i = 0; i < 8; i++) {
+        value |= static_cast<std::uint64_t>(p[i]) << (i * 8);
+    }
+
+    return value;
+}
+
+// Variable length (LEB128) fields: 7 bits per byte, lowest first, with the
+// top bit set on every byte but the last
+
+constexpr unsigned int MAX_VARINT_SIZE = 10;
+
+// Writes value to out, which must hold MAX_VARINT_SIZE bytes, and returns
+// the number of bytes written
+inline unsigned int writeVarint(char* out, std::uint64_t value) {
+    unsigned int written = 0;
+    while (value >= 0x80) {
+        out[written++] = static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out[written++] = static_cast<char>(value);
+
+    return written;
+}
+
+// Reads a value from at most size bytes of in. Returns the number of bytes
+// read, or 0 if the field is truncated or too long for 64 bits.
+inline unsigned int readVarint(const char* in, std::uint64_t size,
+                               std::uint64_t& value) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(in);
+    value                  = 0;
+    for (unsigned int i = 0; i < MAX_VARINT_SIZE && i < size; i++) {
+        std::uint64_t bits = p[i] & 0x7F;
+        if (i == MAX_VARINT_SIZE - 1 && bits > 1) {
+            return 0;
+        }
+
+        value |= bits << (i * 7);
+        if ((p[i] & 0x80) == 0) {
+            return i + 1;
+        }
+    }
+
+    return 0;
+}
+
+}
+
+#endif //! HFM_BYTEORDER_HPP
@@ -0,0 +1,59 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HFM_CODEBUILDER_HPP
+#define HFM_CODEBUILDER_HPP
+
+#include <Kernels.hpp>
+#include <vector>
+#include <cstdint>
+
+namespace hfm {
+
+// Builds canonical Huffman codes from symbol frequencies. All scratch memory
+// is allocated by the constructor, so building codes does not allocate.
+class CodeBuilder {
+public:
+    explicit CodeBuilder(int symbols);
+
+    // Fills codes[symbols] with codes of at most maxLength bits, 0 length for
+    // symbols that do not occur. Returns the longest code length, 0 if no
+    // symbol occurs.
+    unsigned int build(const std::uint64_t* frequencies, Code* codes,
+                       unsigned int maxLength = 64);
+    int getSymbols() const;
+
+    // Fills in the bits of codes[symbols] from their lengths alone, the same
+    // way build() does
+    static void assignCanonicalCodes(Code* codes, int symbols);
+
+private:
+    unsigned int generateLengths(const std::uint64_t* frequencies,
+                                 Code* codes);
+
+private:
+    int m_symbols;
+
+    // Leaves are nodes 0 to m_symbols - 1 and internal nodes are numbered
+    // upwards from m_symbols as they are created
+    std::vector<std::uint64_t> m_frequencies;
+    std::vector<std::uint64_t> m_weights;
+    std::vector<int> m_parents;
+    std::vector<unsigned int> m_depths;
+    std::vector<int> m_heap;
+};
+
+}
+
+#endif //! HFM_CODEBUILDER_HPP
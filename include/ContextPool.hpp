@@ -0,0 +1,42 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HFM_CONTEXTPOOL_HPP
+#define HFM_CONTEXTPOOL_HPP
+
+#include <HuffmanCoder.hpp>
+#include <HuffmanDecoder.hpp>
+#include <cstdint>
+
+namespace hfm {
+
+// One coder, decoder and scratch buffer per thread, reset to a new input on
+// every call. Checksums are turned off again, so a flag set by an earlier
+// user of the thread does not carry over.
+// Meant for many small buffers, where building a fresh context each time
+// would cost more than the compression itself. The returned reference is
+// valid until the next call on the same thread.
+class ContextPool {
+public:
+    static HuffmanCoder& getCoder(const char* inBuff,
+                                  std::uint64_t buffSize);
+    static HuffmanDecoder& getDecoder(const char* inBuff,
+                                      std::uint64_t buffSize);
+    // At least size bytes of memory, with unspecified contents
+    static char* getBuffer(std::uint64_t size);
+};
+
+}
+
+#endif //! HFM_CONTEXTPOOL_HPP
@@ -0,0 +1,71 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HFM_FRAMECODER_HPP
+#define HFM_FRAMECODER_HPP
+
+#include <CodeBuilder.hpp>
+#include <Kernels.hpp>
+#include <cstdint>
+
+namespace hfm {
+
+// Codes small messages, where the fixed costs of a HuffmanCoder stream (the
+// 8 byte size and full codes in the table) would outweigh the saving. A
+// frame is:
+//
+//   varint of (original size << 2 | mode)
+//   RAW:      the original bytes
+//   LIST:     symbol count - 1 (u8), the symbols in ascending order (u8)
+//   MAP:      a 256 bit map of the symbols, lowest symbol in bit 0 of byte 0
+//   LIST/MAP: the code lengths (4 bits each, first symbol in the high
+//             nibble), then the canonical codes packed from the most
+//             significant bit, with the last byte padded with zeros
+//
+// A frame is never more than MAX_OVERHEAD bytes larger than the message:
+// whichever of RAW, LIST and MAP is smallest is written.
+class FrameCoder {
+public:
+    enum Mode : std::uint8_t {
+        RAW  = 0,
+        LIST = 1,
+        MAP  = 2
+    };
+
+    // Codes are limited to fit the 4 bit lengths
+    static constexpr unsigned int MAX_CODE_LENGTH = 15;
+    static constexpr std::uint64_t MAP_SIZE       = 256 / 8;
+    static constexpr std::uint64_t MAX_OVERHEAD   = 10; // Varint header
+    // Largest message a frame can hold, so the header fits 64 bits
+    static constexpr std::uint64_t MAX_SIZE = UINT64_MAX >> 2;
+
+public:
+    FrameCoder();
+    // Writes the frame of size bytes to outBuff, which must hold
+    // getMaxOutput(size) bytes, and returns the frame size
+    std::uint64_t compress(const char* inBuff, std::uint64_t size,
+                           char* outBuff);
+
+    static std::uint64_t getMaxOutput(std::uint64_t size);
+
+private:
+    static constexpr int SYMBOLS = 256;
+
+    CodeBuilder m_builder;
+    Code m_codes[SYMBOLS];
+};
+
+}
+
+#endif //! HFM_FRAMECODER_HPP
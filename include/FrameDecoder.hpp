@@ -0,0 +1,49 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HFM_FRAMEDECODER_HPP
+#define HFM_FRAMEDECODER_HPP
+
+#include <FrameCoder.hpp>
+#include <cstdint>
+
+namespace hfm {
+
+// Decoder for frames written by FrameCoder. Codes are decoded a bit at a
+// time from the counts of every code length, which needs no lookup table
+// and so costs nothing to set up for a message of a few bytes. Like the
+// other decoders it never reads past the input and throws
+// std::runtime_error on a truncated or corrupt frame.
+class FrameDecoder {
+public:
+    // Size of the message in the frame at inBuff
+    static std::uint64_t getOriginalSize(const char* inBuff,
+                                         std::uint64_t buffSize);
+    // Writes the message of the frame at inBuff to outBuff, which must hold
+    // getOriginalSize() bytes. Returns the size of the frame, so frames
+    // sent back to back can be read one after another.
+    std::uint64_t decompress(const char* inBuff, std::uint64_t buffSize,
+                             char* outBuff);
+
+private:
+    static constexpr int SYMBOLS = 256;
+
+    // Number of codes of every length, and the symbols ordered by code
+    unsigned int m_lengthCounts[FrameCoder::MAX_CODE_LENGTH + 1];
+    unsigned char m_sorted[SYMBOLS];
+};
+
+}
+
+#endif //! HFM_FRAMEDECODER_HPP
@@ -0,0 +1,69 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HFM_HISTOGRAM_HPP
+#define HFM_HISTOGRAM_HPP
+
+#include <HuffmanCoder.hpp>
+#include <Kernels.hpp>
+#include <ByteOrder.hpp>
+#include <cstdint>
+
+namespace hfm {
+
+// Byte counts of some data, built up in parts and merged with the counts of
+// other parts, possibly made by other processes and sent over serialized.
+// Codes built from the merged counts cover every part, so each part can be
+// coded on its own with them (see HuffmanCoder::loadDictionary) and the
+// results put together without coding anything again, for example as the
+// members of an archive with a shared table.
+class Histogram {
+public:
+    static constexpr int SYMBOLS = 256;
+    // Shared codes are kept short enough for the fast decoding path
+    static constexpr unsigned int MAX_CODE_LENGTH = 32;
+    // Magic, version and a varint for the count of every byte value
+    static constexpr std::uint64_t MAX_SERIALIZED_SIZE =
+        4 + SYMBOLS * MAX_VARINT_SIZE;
+
+public:
+    Histogram();
+    explicit Histogram(const std::uint64_t* counts);
+    void add(const char* data, std::uint64_t size);
+    // Throws std::runtime_error, leaving the counts as they were, if the
+    // merged counts would add up to more than a serialized histogram holds
+    void merge(const Histogram& other);
+    const std::uint64_t* getCounts() const;
+    std::uint64_t getTotal() const;
+    // Every byte counted by other is counted here too, so codes built from
+    // this histogram can code the data of other
+    bool covers(const Histogram& other) const;
+    // Fills codes[SYMBOLS] with canonical codes of at most MAX_CODE_LENGTH
+    // bits, 0 length for bytes that were not counted. Equal counts always
+    // give equal codes, on every machine.
+    void buildCodes(Code* codes) const;
+    // The codes of buildCodes(), for HuffmanCoder::loadDictionary
+    HuffmanCoder::Dictionary buildDictionary() const;
+    // Writes at most MAX_SERIALIZED_SIZE bytes to out, returns the size
+    std::uint64_t serialize(char* out) const;
+    // Throws std::runtime_error if in does not hold a serialized histogram
+    static Histogram deserialize(const char* in, std::uint64_t size);
+
+private:
+    std::uint64_t m_counts[SYMBOLS];
+};
+
+}
+
+#endif //! HFM_HISTOGRAM_HPP
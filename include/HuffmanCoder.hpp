@@ -15,49 +15,88 @@
 #ifndef HFM_HUFFMANCODER_HPP
 #define HFM_HUFFMANCODER_HPP
 
-#include <PriorityQueue.hpp>
+#include <CodeBuilder.hpp>
 #include <unordered_map>
 #include <string>
 #include <cstdint>
 
 namespace hfm {
 
+// The coder keeps its tables and scratch memory between inputs, so after
+// reset() compressing another buffer does not allocate
 class HuffmanCoder {
 public:
     typedef std::unordered_map<unsigned char, std::string> Dictionary;
 
+    // Size, symbol count and one 64 bit code for each of the 256 bytes
+    static constexpr std::uint64_t MAX_HEADER_SIZE = 8 + 2 + 256 * (2 + 8);
+
 public:
-    HuffmanCoder(char* inBuff, unsigned long buffSize);
+    HuffmanCoder(const char* inBuff, std::uint64_t buffSize);
     HuffmanCoder(const HuffmanCoder& other) = delete; // Non-copyable
     HuffmanCoder(HuffmanCoder&& other) noexcept;
     ~HuffmanCoder() = default;
+    void reset(const char* inBuff, std::uint64_t buffSize);
     Dictionary& getDictionary();
+    // Codes to use instead of ones built from the input, for example codes
+    // shared by many inputs (see Histogram). compress() throws
+    // std::runtime_error if the input has a byte without a code.
     void loadDictionary(const Dictionary& dictionary);
-    long compress(char* outBuff, unsigned long numBytes);
+    // When disabled, the stream header leaves out the codes, for decoders
+    // that already have them loaded. Enabled by default.
+    void setWriteDictionary(bool enabled);
+    // When enabled, a CRC32C of the input is computed while it is coded
+    void setChecksum(bool enabled);
+    std::uint32_t getChecksum() const; // CRC32C of the input coded so far
+    // Byte counts of the whole input, shared with other coders so the input
+    // is only counted once
+    const std::uint64_t* getFrequencies();
+    // Size of the stream compress() will write for the whole input
+    std::uint64_t getCompressedSize();
+    // Writes the stream, returning the bytes written, then -2 if the last
+    // getLastBytes() bytes were left at the start of outBuff, then -1
+    std::int64_t compress(char* outBuff, std::uint64_t numBytes);
+    std::uint64_t getLastBytes() const;
 
     HuffmanCoder& operator=(const HuffmanCoder& other) = delete; // Non-copyable
     HuffmanCoder& operator=(HuffmanCoder&& other) noexcept;
 
+    // Dictionary of codes[256], leaving out bytes with 0 length codes
+    static Dictionary makeDictionary(const Code* codes);
+
 private:
-    void generateDictionary();
-    void fillFrequencies(int* frequencies);
-    void generateTree(const int* frequencies);
-    void fillDictionary(const HuffmanNode* root, std::string code = "");
-    unsigned int writeStreamHeader(char* outBuff);
+    void generateCodes();
+    void fillFrequencies(std::uint64_t* frequencies);
+    std::uint64_t getHeaderSize() const; // Size writeStreamHeader() writes
+    std::uint64_t writeStreamHeader(char* outBuff);
 
 private:
-    Dictionary m_dictionary;
-    PriorityQueue m_tree;
-    char* m_inBuff;
-    char* m_inEnd;
-    unsigned long m_buffSize;
+    static constexpr int SYMBOLS = 256;
+
+    Dictionary m_dictionary; // Built on demand by getDictionary()
+    bool m_dictionaryReady;  // m_dictionary matches m_codes
+    bool m_codesLoaded;      // Codes came from loadDictionary()
+    bool m_writeDictionary;  // Put the codes in the stream header
+    const char* m_inBuff;
+    const char* m_inEnd;
+    std::uint64_t m_buffSize;
     bool m_headerWritten;
+    Code m_codes[SYMBOLS];        // Code of every byte, 0 length if unused
+    unsigned int m_maxCodeLength; // Length of the longest code in bits
+    bool m_codesReady;            // m_codes describes the current input
+
+    std::uint64_t m_frequencies[SYMBOLS];
+    bool m_frequenciesReady; // m_frequencies describes the current input
+    CodeBuilder m_builder;
 
     // Compression state
-    std::uint64_t m_acc;    // 64-bit Accumulator for codes
-    unsigned int m_accUsed; // Used bits in the accumulator
+    std::uint64_t m_acc;       // 64-bit Accumulator for codes
+    unsigned int m_accUsed;    // Used bits in the accumulator
+    std::uint64_t m_lastBytes; // Bytes written by the final flush
+    bool m_checksum;           // Compute m_crc while coding
+    std::uint32_t m_crc;
 };
 
 }
 
-#endif //! HFM_HUFFMANCODER_HPP
\ No newline at end of file
+#endif //! HFM_HUFFMANCODER_HPP
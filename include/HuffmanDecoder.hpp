@@ -15,49 +15,92 @@
 #ifndef HFM_HUFFMANDECODER_HPP
 #define HFM_HUFFMANDECODER_HPP
 
-#include <PriorityQueue.hpp>
+#include <Kernels.hpp>
 #include <unordered_map>
 #include <string>
+#include <cstdint>
 
 namespace hfm {
 
+// Like the coder, the decoder can be reset() to a new input and reuses its
+// tables without allocating. Codes are decoded with a table indexed by the
+// next TABLE_BITS bits of the stream, whose entries hold up to MAX_SYMBOLS
+// whole codes, so one lookup often gives several bytes. Longer codes walk
+// the tree. The input is never read past buffSize: a
+// truncated or corrupt stream makes decompress() throw std::runtime_error.
 class HuffmanDecoder {
 public:
     typedef std::unordered_map<unsigned char, std::string> Dictionary;
     typedef std::unordered_map<std::string, unsigned char> ReverseDictionary;
 
+    static constexpr unsigned int TABLE_BITS  = 11;
+    static constexpr unsigned int MAX_SYMBOLS = 4;
+
 public:
-    HuffmanDecoder(const char* inBuff, unsigned long buffSize);
+    HuffmanDecoder(const char* inBuff, std::uint64_t buffSize);
     HuffmanDecoder(const HuffmanDecoder& other) = delete; // Non-copyable
     HuffmanDecoder(HuffmanDecoder&& other) noexcept;
     ~HuffmanDecoder() = default;
+    void reset(const char* inBuff, std::uint64_t buffSize);
     void loadDictionary(const Dictionary& dict);
     ReverseDictionary& getDecodingDictionary();
-    long decompress(char* outBuff, unsigned long numBytes);
+    std::int64_t decompress(char* outBuff, std::uint64_t numBytes);
     std::uint64_t getLastBytes() const;
+    // When enabled, a CRC32C of the output is computed while it is decoded
+    void setChecksum(bool enabled);
+    std::uint32_t getChecksum() const; // CRC32C of the output so far
 
     HuffmanDecoder&
         operator=(const HuffmanDecoder& other) = delete; // Non-copyable
     HuffmanDecoder& operator=(HuffmanDecoder&& other) noexcept;
 
 private:
-    HuffmanNode* generateTreeFromDictionary();
+    void generateTreeFromCodes();
     void loadDictionaryFromStream();
+    void generateTables();
+    // Decodes count bytes, as fast as the room left in the input allows
+    void decodeSymbols(char* outBuff, std::uint64_t count,
+                       Kernels::RefillFn refill);
+    // Decodes a code longer than TABLE_BITS from the word at m_bitPos
+    char decodeLong(std::uint64_t word);
+    // Decodes one symbol, checking the end of the input
+    char decodeChecked(Kernels::RefillFn refill);
 
 private:
-    ReverseDictionary m_dict;
+    static constexpr int SYMBOLS = 256;
+
+    ReverseDictionary m_dict; // Built on demand by getDecodingDictionary()
+    bool m_dictReady;         // m_dict matches m_codes
     const char* m_inBuff;
-    unsigned long m_inBuffSize;
-    bool m_dictLoaded;
-    unsigned long m_originalSize;
+    std::uint64_t m_inBuffSize;
+    bool m_dictLoaded; // Codes came from loadDictionary()
+    bool m_headerRead;
+    std::uint64_t m_originalSize;
+    Code m_codes[SYMBOLS]; // Code of every byte, 0 length if unused
+
+    // Huffman tree with the root at index 0. A child is the index of an inner
+    // node when positive, the byte ~child when negative and missing when 0.
+    std::int16_t m_tree[SYMBOLS - 1][2];
+    int m_treeSize; // Number of inner nodes, 0 if the tree is not built
+    unsigned int m_maxCodeLength; // Length of the longest code in bits
+
+    // Entry for every TABLE_BITS prefix of the stream: the bytes of the whole
+    // codes it starts with, their number (0 if the first code is longer than
+    // TABLE_BITS) and length, and the length of the first code
+    struct Entry {
+        unsigned char symbols[MAX_SYMBOLS];
+        std::uint8_t count;
+        std::uint8_t bits;
+        std::uint8_t firstBits;
+    };
+    Entry m_table[1 << TABLE_BITS];
 
     // Compression state
     std::uint64_t m_processed; // Number of processed bytes
-    std::uint64_t m_acc;       // 64-bit Accumulator for codes
-    unsigned int m_accUsed;    // Used bits in the accumulator
-    HuffmanNode* m_tree;       // Huffman tree
-    std::uint64_t m_read;      // Number of bytes read from buffer
+    std::uint64_t m_bitPos;    // Number of bits read from the buffer
     std::uint64_t m_lastBytes; // Number of bytes processed last time
+    bool m_checksum;           // Compute m_crc while decoding
+    std::uint32_t m_crc;
 };
 
 }
@@ -0,0 +1,71 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HFM_IOBACKEND_HPP
+#define HFM_IOBACKEND_HPP
+
+#include <memory>
+#include <cstdint>
+
+namespace hfm {
+
+// Queue of positional reads and writes on file descriptors. Requests are
+// collected by submit() and handed over together by flush(), so a batch
+// costs one system call. On Linux this is an io_uring, set up with raw
+// system calls; where that is not available a small pool of threads does
+// the same with pread() and pwrite(). Setting the HFM_IO environment
+// variable to "threads" forces the pool.
+class IoBackend {
+public:
+    struct Request {
+        int fd;
+        char* buffer;
+        std::uint64_t size;
+        std::uint64_t offset;
+        bool write;
+        std::uint64_t tag; // Returned with the completion
+    };
+
+    struct Completion {
+        std::uint64_t tag;
+        std::int64_t result; // Bytes transferred, or -errno
+    };
+
+    // O_DIRECT needs buffers, sizes and offsets aligned to this
+    static constexpr std::uint64_t ALIGNMENT = 4096;
+    // Files of at least this size bypass the page cache (O_DIRECT) when the
+    // HFM_DIRECT environment variable is set to 1
+    static constexpr std::uint64_t DIRECT_THRESHOLD = 64 << 20;
+
+public:
+    virtual ~IoBackend() = default;
+    virtual const char* getName() const = 0;
+    // Queues a request, starting the queue first if it is full. No more
+    // than twice the depth given to create() may be queued or running.
+    virtual void submit(const Request& request) = 0;
+    // Starts every queued request
+    virtual void flush() = 0;
+    // Flushes, then waits for any request to finish
+    virtual Completion wait() = 0;
+
+    // Backend for up to depth requests at a time, nullptr on systems
+    // without positional file I/O
+    static std::unique_ptr<IoBackend> create(unsigned int depth);
+    // Whether a file of the given size should be opened with O_DIRECT
+    static bool isDirectWanted(std::uint64_t size);
+};
+
+}
+
+#endif //! HFM_IOBACKEND_HPP
@@ -0,0 +1,118 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HFM_JOBPOOL_HPP
+#define HFM_JOBPOOL_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+namespace hfm {
+
+// Compresses and decompresses buffers on a pool of worker threads, so a
+// caller such as an event loop is never blocked by the coding itself.
+// Compression writes a block container (see BlockCoder); large inputs are
+// cut into segments coded in parallel and joined into one container.
+// Decompression takes a container, whose blocks are decoded in parallel,
+// or a single HuffmanCoder stream.
+//
+// At most maxJobs jobs are in flight at once. submit() waits for room and
+// trySubmit() refuses the job instead, so producers are slowed down to the
+// speed of the pool rather than queueing without bound.
+class JobPool {
+public:
+    enum Operation { COMPRESS, DECOMPRESS };
+
+    // Receives the output of a job, or the exception that failed it (then
+    // output is empty). Called on a worker thread; the job counts against
+    // maxJobs until it returns, so it should only hand the result over.
+    // Exceptions thrown by the callback are ignored.
+    typedef std::function<void(std::vector<char> output,
+                               std::exception_ptr error)>
+        Callback;
+
+    // Input a worker takes from a job at a time, unless changed with
+    // setSegmentSize(). Inputs up to this size are coded by one worker.
+    static constexpr std::uint64_t SEGMENT_SIZE = 4 << 20;
+
+public:
+    // threads 0 uses one thread per core
+    explicit JobPool(unsigned int threads = 0, unsigned int maxJobs = 64);
+    JobPool(const JobPool& other) = delete; // Non-copyable
+    // Finishes every submitted job first
+    ~JobPool();
+    unsigned int getThreads() const;
+    // Input taken per worker when compressing, SEGMENT_SIZE by default
+    void setSegmentSize(std::uint64_t size);
+    // See BlockCoder::setMaxBlockSize
+    void setMaxBlockSize(std::uint64_t size);
+    // Waits for room, then queues the job. The future throws what the job
+    // threw, std::runtime_error for damaged input.
+    std::future<std::vector<char>> submit(Operation operation,
+                                          std::vector<char> input);
+    void submit(Operation operation, std::vector<char> input,
+                Callback callback);
+    // Queues the job if there is room and returns true. Otherwise returns
+    // false at once and leaves input as it is.
+    bool trySubmit(Operation operation, std::vector<char>&& input,
+                   Callback callback);
+    // Waits until every submitted job has finished
+    void wait();
+
+    JobPool& operator=(const JobPool& other) = delete;
+
+private:
+    struct Job;
+
+    // A part of a job; PLAN splits the job into parts
+    struct Task {
+        std::shared_ptr<Job> job;
+        std::size_t part;
+    };
+
+    static constexpr std::size_t PLAN = static_cast<std::size_t>(-1);
+
+    void enqueue(Operation operation, std::vector<char>&& input,
+                 Callback&& callback);
+    void work();
+    void plan(const std::shared_ptr<Job>& job);
+    void runPart(Job& job, std::size_t part);
+    // Counts a finished part, completing the job after its last one
+    void finishPart(const std::shared_ptr<Job>& job);
+    void complete(Job& job);
+
+private:
+    unsigned int m_maxJobs;
+    std::uint64_t m_segmentSize;  // Given to the jobs as they are queued
+    std::uint64_t m_maxBlockSize;
+    unsigned int m_jobs; // Jobs submitted and not yet completed
+    bool m_stop;
+    std::deque<Task> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_work; // A task was queued, or m_stop set
+    std::condition_variable m_room; // A job was completed
+    std::vector<std::thread> m_threads;
+};
+
+}
+
+#endif //! HFM_JOBPOOL_HPP
@@ -0,0 +1,70 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HFM_KERNELS_HPP
+#define HFM_KERNELS_HPP
+
+#include <cstdint>
+
+namespace hfm {
+
+// A code right-aligned in bits, with its length in bits
+struct Code {
+    std::uint64_t bits;
+    unsigned int length;
+};
+
+// Hot loops of the coder and decoder, picked once at startup from the
+// variants the running CPU supports. Setting the HFM_DISPATCH environment
+// variable to "scalar" forces the portable variants.
+class Kernels {
+public:
+    // Adds the number of occurrences of every byte value to counts[256]
+    typedef void (*HistogramFn)(const unsigned char* data, std::uint64_t size,
+                                std::uint64_t* counts);
+    // Appends the codes of count symbols to the accumulator, flushing every
+    // full 64 bit word (big endian) to out. Returns the number of bytes
+    // written. Codes must be at most 64 bits long.
+    typedef std::uint64_t (*EncodeFn)(const unsigned char* in,
+                                      std::uint64_t count, const Code* codes,
+                                      std::uint64_t& acc, unsigned int& accUsed,
+                                      char* out);
+    // Reads the next 64 bit (big endian) word of the bit stream
+    typedef std::uint64_t (*RefillFn)(const char* in);
+    // Extends a CRC32C (Castagnoli) checksum with size bytes. Start with 0;
+    // the result can be passed back in to continue over more data.
+    typedef std::uint32_t (*Crc32cFn)(std::uint32_t crc,
+                                      const unsigned char* data,
+                                      std::uint64_t size);
+
+public:
+    static const Kernels& get(); // Kernels selected for the running CPU
+
+public:
+    HistogramFn histogram;
+    EncodeFn encode;
+    RefillFn refill;
+    Crc32cFn crc32c;
+    const char* histogramName; // Name of the selected variants
+    const char* encodeName;
+    const char* refillName;
+    const char* crc32cName;
+
+private:
+    Kernels();
+};
+
+}
+
+#endif //! HFM_KERNELS_HPP
@@ -0,0 +1,48 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HFM_MAPPEDFILE_HPP
+#define HFM_MAPPEDFILE_HPP
+
+#include <cstdint>
+
+namespace hfm {
+
+// Read-only view of a whole file. On POSIX systems the file is mapped into
+// memory, so pages are only read when they are used; elsewhere it is read
+// into a buffer.
+class MappedFile {
+public:
+    explicit MappedFile(const char* path);
+    MappedFile(const MappedFile& other) = delete; // Non-copyable
+    MappedFile(MappedFile&& other) noexcept;
+    ~MappedFile();
+    const char* getData() const;
+    std::uint64_t getSize() const;
+
+    MappedFile& operator=(const MappedFile& other) = delete; // Non-copyable
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+private:
+    void release();
+
+private:
+    const char* m_data;
+    std::uint64_t m_size;
+    bool m_mapped; // m_data is a mapping, not a buffer from new[]
+};
+
+}
+
+#endif //! HFM_MAPPEDFILE_HPP
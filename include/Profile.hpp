@@ -0,0 +1,51 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HFM_PROFILE_HPP
+#define HFM_PROFILE_HPP
+
+#include <string>
+#include <cstdint>
+
+namespace hfm {
+
+// Settings picked for a machine by Autotuner and kept in a small text file
+// of "key=value" lines, which later runs load on their own. The file is
+// named by the HFM_PROFILE environment variable, or is .huffman-profile in
+// the home directory.
+class Profile {
+public:
+    static constexpr unsigned int VERSION = 1;
+
+public:
+    Profile(); // Defaults, used without a profile file
+    // Profile of this machine, loaded once. Throws std::runtime_error if
+    // the file exists but cannot be read.
+    static const Profile& get();
+    // Path of the profile file, empty if there is no home directory
+    static std::string getDefaultPath();
+    // Throws std::runtime_error if the file cannot be read or holds invalid
+    // settings
+    static Profile load(const std::string& path);
+    void save(const std::string& path) const;
+
+public:
+    unsigned int threads;       // Worker threads of the parallel modes
+    std::uint64_t segmentSize;  // Input per thread, see JobPool
+    std::uint64_t maxBlockSize; // See BlockCoder::setMaxBlockSize
+};
+
+}
+
+#endif //! HFM_PROFILE_HPP
@@ -0,0 +1,61 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HFM_RANSCODER_HPP
+#define HFM_RANSCODER_HPP
+
+#include <cstdint>
+
+namespace hfm {
+
+// Range ANS coder over bytes. Symbol probabilities are multiples of
+// 1 / 2^SCALE_BITS instead of powers of two, so skewed data costs close to
+// its entropy. STREAMS states are interleaved (symbol i uses state
+// i % STREAMS) and share one stream of 16 bit words, so the decoder can work
+// on several symbols at once.
+//
+// Stream: symbol count (u16), then for every symbol its value (u8) and
+// scaled frequency (u16), the final states (u32 each) and the words, all
+// little endian. The size of the data is not part of the stream.
+class RansCoder {
+public:
+    static constexpr unsigned int SCALE_BITS = 12;
+    static constexpr int STREAMS             = 4;
+    // States are kept in [STATE_LOW, 2^32)
+    static constexpr std::uint32_t STATE_LOW = 1u << 16;
+
+public:
+    RansCoder();
+    // Scales the byte counts of the data to sum to 2^SCALE_BITS, keeping
+    // every byte that occurs
+    void setFrequencies(const std::uint64_t* frequencies);
+    // Estimated size of the stream for the data the frequencies came from
+    std::uint64_t estimateSize() const;
+    // Codes size bytes into at most numBytes of outBuff and returns the
+    // stream size, or 0 if it does not fit
+    std::uint64_t compress(const char* inBuff, std::uint64_t size,
+                           char* outBuff, std::uint64_t numBytes) const;
+
+private:
+    static constexpr int SYMBOLS = 256;
+
+    std::uint64_t m_counts[SYMBOLS];
+    std::uint32_t m_frequencies[SYMBOLS]; // Scaled, 0 for unused bytes
+    std::uint32_t m_starts[SYMBOLS];      // Sum of the frequencies before
+    int m_symbols;                        // Number of used bytes
+};
+
+}
+
+#endif //! HFM_RANSCODER_HPP
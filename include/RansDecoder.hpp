@@ -0,0 +1,60 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HFM_RANSDECODER_HPP
+#define HFM_RANSDECODER_HPP
+
+#include <RansCoder.hpp>
+#include <cstdint>
+
+namespace hfm {
+
+// Decoder for streams written by RansCoder. Symbols are looked up in a table
+// with an entry for every one of the 2^SCALE_BITS slots. Like
+// HuffmanDecoder, it never reads past the input and throws
+// std::runtime_error on a truncated or corrupt stream.
+class RansDecoder {
+public:
+    RansDecoder();
+    void reset(const char* inBuff, std::uint64_t buffSize);
+    // Decodes the next numBytes bytes to outBuff; may be called repeatedly
+    void decompress(char* outBuff, std::uint64_t numBytes);
+    // Checks that the whole stream has been decoded
+    void finish() const;
+
+private:
+    void loadTableFromStream();
+
+private:
+    static constexpr int SLOTS = 1 << RansCoder::SCALE_BITS;
+
+    struct Entry {
+        std::uint16_t frequency;
+        std::uint16_t bias; // Slot minus the start of the symbol
+        std::uint8_t symbol;
+    };
+
+    const char* m_inBuff;
+    std::uint64_t m_inBuffSize;
+    Entry m_table[SLOTS];
+
+    // Decompression state
+    std::uint32_t m_states[RansCoder::STREAMS];
+    std::uint64_t m_read;     // Number of bytes read from buffer
+    std::uint64_t m_position; // Number of decoded bytes
+};
+
+}
+
+#endif //! HFM_RANSDECODER_HPP
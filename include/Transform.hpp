@@ -0,0 +1,60 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HFM_TRANSFORM_HPP
+#define HFM_TRANSFORM_HPP
+
+#include <cstdint>
+
+namespace hfm {
+
+// Reversible rewrite of a block before it is entropy coded, turning
+// structure an order-0 coder cannot see (runs, slowly changing values,
+// locally repeated bytes) into skewed byte counts. Transforms hold no state,
+// so the instances returned by get() are shared by all threads. A new
+// transform gets a Type and a case in get().
+class Transform {
+public:
+    enum Type : std::uint8_t {
+        NONE  = 0,
+        DELTA = 1, // Difference to the previous byte
+        RLE   = 2, // Runs of a byte stored as two bytes and a count
+        MTF   = 3  // Move-to-front: index of the byte in a recency list
+    };
+
+    static constexpr int TYPES = 4;
+
+public:
+    virtual ~Transform() = default;
+    virtual const char* getName() const = 0;
+    // Largest output forward() can write for size bytes
+    virtual std::uint64_t getMaxOutput(std::uint64_t size) const = 0;
+    // Writes the transformed data to outBuff and returns its size
+    virtual std::uint64_t forward(const char* inBuff, std::uint64_t size,
+                                  char* outBuff) const = 0;
+    // Restores exactly numBytes bytes from the output of forward(). Throws
+    // std::runtime_error if inBuff does not decode to that many bytes.
+    virtual void inverse(const char* inBuff, std::uint64_t size,
+                         char* outBuff, std::uint64_t numBytes) const = 0;
+
+    // The transform of the given type, nullptr for NONE
+    static const Transform* get(Type type);
+    // Transform expected to give the smallest coded output, estimated from
+    // a few samples of the data
+    static Type choose(const char* data, std::uint64_t size);
+};
+
+}
+
+#endif //! HFM_TRANSFORM_HPP
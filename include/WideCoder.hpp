@@ -0,0 +1,74 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HFM_WIDECODER_HPP
+#define HFM_WIDECODER_HPP
+
+#include <CodeBuilder.hpp>
+#include <vector>
+#include <cstdint>
+
+namespace hfm {
+
+// Coder over 16 bit symbols (pairs of bytes), for text where byte pairs
+// are far more predictable than single bytes. Codes are limited to MAX_BITS
+// so the decoding tables stay small. An odd last byte is coded as a pair
+// with a zero byte, which the decoder drops.
+//
+// Stream: original size (u64), symbol count (u32), then for every symbol
+// its value (u16) and code length (u8), all little endian, followed by the
+// canonical codes of the pairs, most significant bit first.
+class WideCoder {
+public:
+    static constexpr int SYMBOLS           = 1 << 16;
+    static constexpr unsigned int MAX_BITS = 20;
+    static constexpr std::uint64_t MAX_HEADER_SIZE = 8 + 4 + SYMBOLS * 3;
+
+public:
+    WideCoder(const char* inBuff, std::uint64_t buffSize);
+    WideCoder(const WideCoder& other) = delete; // Non-copyable
+    WideCoder(WideCoder&& other) noexcept = default;
+    ~WideCoder() = default;
+    void reset(const char* inBuff, std::uint64_t buffSize);
+    // Writes at most numBytes to outBuff and returns how many were written,
+    // or -1 once the whole stream has been written. The first call writes
+    // the header and needs room for it.
+    std::int64_t compress(char* outBuff, std::uint64_t numBytes);
+
+    WideCoder& operator=(const WideCoder& other) = delete; // Non-copyable
+    WideCoder& operator=(WideCoder&& other) noexcept = default;
+
+private:
+    void generateCodes();
+    std::uint64_t writeStreamHeader(char* outBuff);
+
+private:
+    const unsigned char* m_inBuff;
+    const unsigned char* m_inEnd;
+    std::uint64_t m_buffSize;
+    bool m_headerWritten;
+    bool m_finished;
+    std::vector<std::uint64_t> m_frequencies;
+    std::vector<Code> m_codes;
+    unsigned int m_symbolCount; // Number of symbols with a code
+    CodeBuilder m_builder;
+
+    // Compression state
+    std::uint64_t m_acc;    // 64-bit Accumulator for codes
+    unsigned int m_accUsed; // Used bits in the accumulator
+};
+
+}
+
+#endif //! HFM_WIDECODER_HPP
@@ -0,0 +1,75 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HFM_WIDEDECODER_HPP
+#define HFM_WIDEDECODER_HPP
+
+#include <Kernels.hpp>
+#include <vector>
+#include <cstdint>
+
+namespace hfm {
+
+// Decoder for streams written by WideCoder. Codes up to TABLE_BITS long are
+// resolved with one table lookup, longer ones from the canonical code
+// ranges of each length.
+class WideDecoder {
+public:
+    static constexpr unsigned int TABLE_BITS = 12;
+
+public:
+    WideDecoder(const char* inBuff, std::uint64_t buffSize);
+    WideDecoder(const WideDecoder& other) = delete; // Non-copyable
+    WideDecoder(WideDecoder&& other) noexcept = default;
+    ~WideDecoder() = default;
+    void reset(const char* inBuff, std::uint64_t buffSize);
+    // Writes at most numBytes (at least 2) to outBuff and returns how many
+    // were written, or -1 once the whole stream has been decoded
+    std::int64_t decompress(char* outBuff, std::uint64_t numBytes);
+
+    WideDecoder& operator=(const WideDecoder& other) = delete; // Non-copyable
+    WideDecoder& operator=(WideDecoder&& other) noexcept = default;
+
+private:
+    void loadDictionaryFromStream();
+    void generateTables();
+    void refill();
+    unsigned int decodeSymbol();
+
+private:
+    const char* m_inBuff;
+    std::uint64_t m_inBuffSize;
+    bool m_headerRead;
+    std::uint64_t m_originalSize;
+    std::vector<Code> m_codes;
+
+    // Entry for every TABLE_BITS prefix: symbol in the low 16 bits and code
+    // length above, 0 if the code is longer than TABLE_BITS
+    std::vector<std::uint32_t> m_table;
+    // Canonical ranges of every code length, for the long codes
+    std::vector<std::uint32_t> m_firstCode;
+    std::vector<std::uint32_t> m_lengthCounts;
+    std::vector<std::uint32_t> m_offsets;
+    std::vector<std::uint16_t> m_sorted;
+
+    // Decompression state
+    std::uint64_t m_processed; // Number of decoded bytes
+    std::uint64_t m_read;      // Number of bytes read from buffer
+    std::uint64_t m_acc;       // Bits not yet decoded, from the MSB
+    unsigned int m_accBits;    // Number of valid bits in the accumulator
+};
+
+}
+
+#endif //! HFM_WIDEDECODER_HPP
@@ -0,0 +1,102 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <AdaptiveCoder.hpp>
+#include <stdexcept>
+
+namespace {
+
+constexpr unsigned int BYTE_BITS = 8;
+
+}
+
+namespace hfm {
+
+AdaptiveCoder::AdaptiveCoder() : m_finished(false), m_acc(0), m_accUsed(0) {}
+
+void AdaptiveCoder::reset() {
+    m_model.reset();
+    m_finished = false;
+    m_acc      = 0;
+    m_accUsed  = 0;
+}
+
+std::uint64_t AdaptiveCoder::compress(const char* inBuff, std::uint64_t size,
+                                      char* outBuff) {
+    if (m_finished) {
+        throw std::logic_error("Stream already finished");
+    }
+
+    std::uint64_t bytesWrote = 0;
+    for (std::uint64_t i = 0; i < size; i++) {
+        bytesWrote += writeSymbol(static_cast<unsigned char>(inBuff[i]),
+                                  outBuff + bytesWrote);
+    }
+
+    return bytesWrote;
+}
+
+std::uint64_t AdaptiveCoder::flush(char* outBuff) {
+    if (m_finished) {
+        throw std::logic_error("Stream already finished");
+    }
+
+    std::uint64_t bytesWrote = writeSymbol(AdaptiveModel::FLUSH, outBuff);
+    return bytesWrote + padToByte(outBuff + bytesWrote);
+}
+
+std::uint64_t AdaptiveCoder::finish(char* outBuff) {
+    if (m_finished) {
+        return 0;
+    }
+
+    std::uint64_t bytesWrote = writeSymbol(AdaptiveModel::END, outBuff);
+    m_finished               = true;
+    return bytesWrote + padToByte(outBuff + bytesWrote);
+}
+
+std::uint64_t AdaptiveCoder::getMaxOutput(std::uint64_t size) {
+    // Every symbol, plus a control symbol and the padding after it
+    return (size + 1) * AdaptiveModel::MAX_BITS / BYTE_BITS + 1;
+}
+
+std::uint64_t AdaptiveCoder::writeSymbol(int symbol, char* outBuff) {
+    const Code& code = m_model.getCode(symbol);
+    m_acc            = (m_acc << code.length) | code.bits;
+    m_accUsed += code.length;
+
+    // Write every complete byte, the rest waits for the next code
+    std::uint64_t bytesWrote = 0;
+    while (m_accUsed >= BYTE_BITS) {
+        m_accUsed -= BYTE_BITS;
+        outBuff[bytesWrote++] = static_cast<char>((m_acc >> m_accUsed) & 0xFF);
+    }
+
+    m_model.update(symbol);
+    return bytesWrote;
+}
+
+std::uint64_t AdaptiveCoder::padToByte(char* outBuff) {
+    if (m_accUsed == 0) {
+        return 0;
+    }
+
+    outBuff[0] =
+        static_cast<char>((m_acc << (BYTE_BITS - m_accUsed)) & 0xFF);
+    m_acc     = 0;
+    m_accUsed = 0;
+    return 1;
+}
+
+}
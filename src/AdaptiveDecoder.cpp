@@ -0,0 +1,82 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <AdaptiveDecoder.hpp>
+#include <stdexcept>
+
+namespace {
+
+constexpr unsigned int BYTE_BITS = 8;
+
+}
+
+namespace hfm {
+
+AdaptiveDecoder::AdaptiveDecoder()
+    : m_finished(false), m_code(0), m_codeUsed(0) {}
+
+void AdaptiveDecoder::reset() {
+    m_model.reset();
+    m_finished = false;
+    m_code     = 0;
+    m_codeUsed = 0;
+}
+
+std::uint64_t AdaptiveDecoder::decompress(const char* inBuff,
+                                          std::uint64_t size, char* outBuff) {
+    std::uint64_t bytesWrote = 0;
+
+    for (std::uint64_t i = 0; i < size && !m_finished; i++) {
+        unsigned char byte = static_cast<unsigned char>(inBuff[i]);
+
+        for (int bit = BYTE_BITS - 1; bit >= 0; bit--) {
+            m_code = (m_code << 1) | ((byte >> bit) & 1);
+            m_codeUsed++;
+
+            int symbol = m_model.findSymbol(m_code, m_codeUsed);
+            if (symbol < 0) {
+                if (m_codeUsed == AdaptiveModel::MAX_BITS) {
+                    throw std::runtime_error("Invalid code in stream");
+                }
+                continue;
+            }
+
+            m_code     = 0;
+            m_codeUsed = 0;
+            m_model.update(symbol);
+
+            if (symbol < AdaptiveModel::BYTE_SYMBOLS) {
+                outBuff[bytesWrote++] = static_cast<char>(symbol);
+            } else if (symbol == AdaptiveModel::FLUSH) {
+                break; // The rest of the byte is padding
+            } else {
+                m_finished = true;
+                break;
+            }
+        }
+    }
+
+    return bytesWrote;
+}
+
+bool AdaptiveDecoder::isFinished() const {
+    return m_finished;
+}
+
+std::uint64_t AdaptiveDecoder::getMaxOutput(std::uint64_t size) {
+    // Codes are at least one bit long
+    return size * BYTE_BITS;
+}
+
+}
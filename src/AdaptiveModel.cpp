@@ -0,0 +1,113 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <AdaptiveModel.hpp>
+
+namespace {
+
+constexpr unsigned int INITIAL_INTERVAL = 32;
+constexpr unsigned int MAX_INTERVAL     = 4096;
+constexpr std::uint64_t COUNT_LIMIT     = 1 << 18;
+
+}
+
+namespace hfm {
+
+AdaptiveModel::AdaptiveModel() : m_builder(SYMBOLS) {
+    reset();
+}
+
+void AdaptiveModel::reset() {
+    // Every symbol starts as possible, so it always has a code
+    for (auto& count : m_counts) {
+        count = 1;
+    }
+    m_total        = SYMBOLS;
+    m_interval     = INITIAL_INTERVAL;
+    m_sinceRebuild = 0;
+
+    rebuild();
+}
+
+const Code& AdaptiveModel::getCode(int symbol) const {
+    return m_codes[symbol];
+}
+
+int AdaptiveModel::findSymbol(std::uint64_t code, unsigned int length) const {
+    if (length == 0 || length > MAX_BITS) {
+        return -1;
+    }
+
+    std::uint64_t index = code - m_firstCode[length];
+    if (code < m_firstCode[length] || index >= m_lengthCounts[length]) {
+        return -1;
+    }
+
+    return m_sorted[m_offsets[length] + index];
+}
+
+void AdaptiveModel::update(int symbol) {
+    m_counts[symbol]++;
+    m_total++;
+
+    if (++m_sinceRebuild < m_interval) {
+        return;
+    }
+
+    if (m_total > COUNT_LIMIT) {
+        m_total = 0;
+        for (auto& count : m_counts) {
+            count = (count + 1) / 2;
+            m_total += count;
+        }
+    }
+
+    if (m_interval < MAX_INTERVAL) {
+        m_interval *= 2;
+    }
+    m_sinceRebuild = 0;
+
+    rebuild();
+}
+
+void AdaptiveModel::rebuild() {
+    m_builder.build(m_counts, m_codes, MAX_BITS);
+
+    for (unsigned int i = 0; i <= MAX_BITS; i++) {
+        m_firstCode[i]    = 0;
+        m_lengthCounts[i] = 0;
+    }
+    for (const auto& code : m_codes) {
+        m_lengthCounts[code.length]++;
+    }
+
+    unsigned int offset = 0;
+    for (unsigned int length = 1; length <= MAX_BITS; length++) {
+        m_offsets[length] = offset;
+        offset += m_lengthCounts[length];
+    }
+
+    // Canonical codes are assigned in symbol order within one length, so the
+    // first symbol of each length holds the first code
+    unsigned int filled[MAX_BITS + 1] = {};
+    for (int i = 0; i < SYMBOLS; i++) {
+        unsigned int length = m_codes[i].length;
+        if (filled[length] == 0) {
+            m_firstCode[length] = m_codes[i].bits;
+        }
+        m_sorted[m_offsets[length] + filled[length]++] = i;
+    }
+}
+
+}
@@ -0,0 +1,335 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <ArchiveReader.hpp>
+#include <BlockDecoder.hpp>
+#include <HuffmanCoder.hpp>
+#include <ContextPool.hpp>
+#include <CodeBuilder.hpp>
+#include <ByteOrder.hpp>
+#include <Kernels.hpp>
+#include <AsyncWriter.hpp>
+#include <stdexcept>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <cstring>
+
+namespace {
+
+constexpr int FREQ_SIZE = 256;
+
+}
+
+namespace hfm {
+
+ArchiveReader::ArchiveReader(const char* inBuff, std::uint64_t buffSize)
+    : m_inBuff(inBuff), m_inBuffSize(buffSize), m_dataStart(0),
+      m_shared(false), m_sharedCodes() {
+    readHeader();
+    readDirectory();
+}
+
+const std::vector<ArchiveReader::Member>& ArchiveReader::getMembers() const {
+    return m_members;
+}
+
+const ArchiveReader::Member*
+    ArchiveReader::findMember(const std::string& name) const {
+    auto it = m_index.find(name);
+    return it != m_index.end() ? &m_members[it->second] : nullptr;
+}
+
+const char* ArchiveReader::getMemberData(const Member& member) const {
+    return m_inBuff + member.offset;
+}
+
+const Code* ArchiveReader::getSharedCodes() const {
+    return m_shared ? m_sharedCodes : nullptr;
+}
+
+HuffmanDecoder ArchiveReader::createDecoder() const {
+    HuffmanDecoder decoder(nullptr, 0);
+    if (m_shared) {
+        decoder.loadDictionary(m_sharedDictionary);
+    }
+
+    return decoder;
+}
+
+void ArchiveReader::extract(const Member& member, char* outBuff,
+                            HuffmanDecoder& decoder) const {
+    const char* data = m_inBuff + member.offset;
+
+    if (member.method == ArchiveFormat::BLOCKS) {
+        // Blocks carry their own checksums
+        BlockDecoder blocks(data, member.compressedSize);
+        if (blocks.getOriginalSize() != member.originalSize) {
+            throw std::runtime_error("Member size does not match its data");
+        }
+
+        HuffmanDecoder& blockDecoder = ContextPool::getDecoder(nullptr, 0);
+        for (const auto& block : blocks.getBlocks()) {
+            BlockDecoder::decodeBlock(data, block, outBuff + block.outputOffset,
+                                      blockDecoder);
+        }
+        return;
+    }
+
+    std::uint32_t crc = 0;
+    if (member.method == ArchiveFormat::STORED) {
+        if (member.compressedSize != member.originalSize) {
+            throw std::runtime_error("Member size does not match its data");
+        }
+
+        std::memcpy(outBuff, data, member.originalSize);
+        crc = Kernels::get().crc32c(
+            0, reinterpret_cast<const unsigned char*>(outBuff),
+            member.originalSize);
+    } else {
+        if (!m_shared) {
+            throw std::runtime_error("Archive has no shared table");
+        }
+
+        decoder.reset(data, member.compressedSize);
+        decoder.setChecksum(true);
+        std::uint64_t done = 0;
+        while (done < member.originalSize) {
+            std::int64_t written = decoder.decompress(
+                outBuff + done, member.originalSize - done);
+            if (written == -2) {
+                written = decoder.getLastBytes();
+            }
+
+            if (written <= 0) {
+                break;
+            }
+
+            done += written;
+        }
+
+        if (done != member.originalSize) {
+            throw std::runtime_error("Member size does not match its data");
+        }
+        crc = decoder.getChecksum();
+    }
+
+    if (crc != member.checksum) {
+        throw std::runtime_error("Member checksum mismatch");
+    }
+}
+
+void ArchiveReader::extractAll(const std::filesystem::path& directory,
+                               unsigned int threads) const {
+    extractEach(threads, [&](const Member& member, const char* data) {
+        std::filesystem::path path = directory / getSafePath(member.name);
+        std::filesystem::create_directories(path.parent_path());
+        AsyncWriter out(path.string().c_str(), member.originalSize);
+        out.write(data, member.originalSize);
+        out.finish();
+    });
+}
+
+std::uint64_t ArchiveReader::verify(unsigned int threads) const {
+    extractEach(threads, [](const Member&, const char*) {});
+
+    std::uint64_t size = 0;
+    for (const auto& member : m_members) {
+        size += member.originalSize;
+    }
+
+    return size;
+}
+
+void ArchiveReader::extractEach(
+    unsigned int threads,
+    const std::function<void(const Member&, const char*)>& use) const {
+    std::atomic<std::size_t> next(0);
+    std::atomic<bool> failed(false);
+    std::exception_ptr error;
+    std::mutex errorMutex;
+
+    // Workers take the next member until all are done or one has failed
+    auto worker = [&]() {
+        HuffmanDecoder decoder = createDecoder();
+        std::vector<char> buffer;
+
+        for (std::size_t i = next++; i < m_members.size() && !failed;
+             i = next++) {
+            try {
+                const Member& member = m_members[i];
+                buffer.resize(member.originalSize);
+                extract(member, buffer.data(), decoder);
+                use(member, buffer.data());
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!failed) {
+                    error  = std::current_exception();
+                    failed = true;
+                }
+            }
+        }
+    };
+
+    if (threads > m_members.size()) {
+        threads = static_cast<unsigned int>(m_members.size());
+    }
+
+    std::vector<std::thread> pool;
+    for (unsigned int i = 1; i < threads; i++) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+std::filesystem::path ArchiveReader::getSafePath(const std::string& name) {
+    std::filesystem::path path(name);
+    if (name.empty() || path.has_root_path()) {
+        throw std::runtime_error("Unsafe member name: " + name);
+    }
+
+    for (const auto& part : path) {
+        if (part == "..") {
+            throw std::runtime_error("Unsafe member name: " + name);
+        }
+    }
+
+    return path;
+}
+
+std::uint64_t ArchiveReader::getMaxOriginalSize(const Member& member) {
+    switch (member.method) {
+    case ArchiveFormat::STORED:
+        return member.compressedSize;
+    case ArchiveFormat::SHARED:
+        return member.compressedSize * 8; // At least one bit per byte
+    default:
+        // Every block has a header and holds at most MAX_BLOCK_SIZE bytes
+        return (member.compressedSize / BlockFormat::BLOCK_HEADER_SIZE + 1) *
+               BlockFormat::MAX_BLOCK_SIZE;
+    }
+}
+
+void ArchiveReader::readHeader() {
+    if (!ArchiveFormat::isArchive(m_inBuff, m_inBuffSize)) {
+        throw std::runtime_error("Not an archive");
+    }
+
+    if (static_cast<std::uint8_t>(m_inBuff[8]) != ArchiveFormat::VERSION) {
+        throw std::runtime_error("Unsupported archive version");
+    }
+
+    m_shared   = (m_inBuff[9] & ArchiveFormat::SHARED_TABLE) != 0;
+    m_dataStart = ArchiveFormat::HEADER_SIZE;
+    if (!m_shared) {
+        return;
+    }
+
+    // Shared code lengths, turned back into the canonical codes
+    if (m_inBuffSize - m_dataStart < 2) {
+        throw std::runtime_error("Truncated archive header");
+    }
+    unsigned int symbols = readLE16(m_inBuff + m_dataStart);
+    m_dataStart += 2;
+    if (symbols > FREQ_SIZE || m_inBuffSize - m_dataStart < symbols * 2) {
+        throw std::runtime_error("Invalid archive header");
+    }
+
+    Code* codes = m_sharedCodes;
+    for (unsigned int i = 0; i < symbols; i++) {
+        const char* entry   = m_inBuff + m_dataStart + i * 2;
+        unsigned char symbol = static_cast<unsigned char>(entry[0]);
+        unsigned int length  = static_cast<unsigned char>(entry[1]);
+        if (length == 0 || length > 64) {
+            throw std::runtime_error("Invalid archive header");
+        }
+        codes[symbol].length = length;
+    }
+    m_dataStart += symbols * 2;
+    CodeBuilder::assignCanonicalCodes(codes, FREQ_SIZE);
+
+    m_sharedDictionary = HuffmanCoder::makeDictionary(codes);
+
+    // Check the codes once, so damaged tables fail here and not in a worker
+    createDecoder();
+}
+
+void ArchiveReader::readDirectory() {
+    const char* trailer =
+        m_inBuff + m_inBuffSize - ArchiveFormat::TRAILER_SIZE;
+    if (m_inBuffSize < m_dataStart + ArchiveFormat::TRAILER_SIZE ||
+        std::memcmp(trailer + 20, ArchiveFormat::END_MAGIC,
+                    sizeof(ArchiveFormat::END_MAGIC)) != 0) {
+        throw std::runtime_error("Archive has no directory");
+    }
+
+    std::uint64_t offset = readLE64(trailer);
+    std::uint64_t size   = readLE64(trailer + 8);
+    std::uint32_t count  = readLE32(trailer + 16);
+    std::uint64_t end    = m_inBuffSize - ArchiveFormat::TRAILER_SIZE;
+    if (offset < m_dataStart || offset > end || size != end - offset ||
+        count > size / ArchiveFormat::ENTRY_SIZE) {
+        throw std::runtime_error("Invalid archive directory");
+    }
+
+    m_members.clear();
+    m_index.clear();
+    m_members.reserve(count);
+    const char* entry = m_inBuff + offset;
+    const char* last  = m_inBuff + end;
+    for (std::uint32_t i = 0; i < count; i++) {
+        if (static_cast<std::uint64_t>(last - entry) <
+            ArchiveFormat::ENTRY_SIZE) {
+            throw std::runtime_error("Invalid archive directory");
+        }
+
+        std::uint16_t nameSize = readLE16(entry);
+        if (static_cast<std::uint64_t>(last - entry) <
+            ArchiveFormat::ENTRY_SIZE + nameSize) {
+            throw std::runtime_error("Invalid archive directory");
+        }
+
+        Member member;
+        member.name.assign(entry + 2, nameSize);
+        const char* fields    = entry + 2 + nameSize;
+        member.method         = static_cast<std::uint8_t>(fields[0]);
+        member.originalSize   = readLE64(fields + 1);
+        member.compressedSize = readLE64(fields + 9);
+        member.offset         = readLE64(fields + 17);
+        member.checksum       = readLE32(fields + 25);
+        entry                 = fields + ArchiveFormat::ENTRY_SIZE - 2;
+
+        if (member.method > ArchiveFormat::SHARED ||
+            member.offset < m_dataStart || member.offset > offset ||
+            member.compressedSize > offset - member.offset ||
+            member.originalSize > getMaxOriginalSize(member)) {
+            throw std::runtime_error("Invalid archive directory");
+        }
+
+        if (!m_index.emplace(member.name, m_members.size()).second) {
+            throw std::runtime_error("Duplicate member name " + member.name);
+        }
+        m_members.push_back(std::move(member));
+    }
+}
+
+}
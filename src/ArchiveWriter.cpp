@@ -0,0 +1,295 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <ArchiveWriter.hpp>
+#include <CodeBuilder.hpp>
+#include <ByteOrder.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+
+namespace {
+
+constexpr int FREQ_SIZE = 256;
+constexpr int BYTES     = 8;
+
+}
+
+namespace hfm {
+
+ArchiveWriter::ArchiveWriter(std::ostream& out)
+    : m_stream(&out), m_file(nullptr), m_headerWritten(false),
+      m_shared(false), m_sharedMaxMember(0), m_codes(), m_coder(nullptr, 0),
+      m_blocks(nullptr, 0), m_offset(0) {}
+
+ArchiveWriter::ArchiveWriter(AsyncWriter& out)
+    : m_stream(nullptr), m_file(&out), m_headerWritten(false),
+      m_shared(false), m_sharedMaxMember(0), m_codes(), m_coder(nullptr, 0),
+      m_blocks(nullptr, 0), m_offset(0) {}
+
+void ArchiveWriter::setSharedTable(const std::uint64_t* frequencies) {
+    setSharedTable(Histogram(frequencies));
+}
+
+void ArchiveWriter::setSharedTable(const Histogram& histogram,
+                                   std::uint64_t maxMember) {
+    Code codes[FREQ_SIZE];
+    histogram.buildCodes(codes);
+    setSharedCodes(codes, maxMember);
+}
+
+void ArchiveWriter::setSharedCodes(const Code* codes,
+                                   std::uint64_t maxMember) {
+    if (m_headerWritten) {
+        throw std::logic_error("Shared table must be set before any member");
+    }
+
+    std::copy(codes, codes + FREQ_SIZE, m_codes);
+    m_coder.loadDictionary(HuffmanCoder::makeDictionary(m_codes));
+    m_coder.setWriteDictionary(false);
+    m_coder.setChecksum(true);
+    m_shared          = true;
+    m_sharedMaxMember = maxMember;
+}
+
+void ArchiveWriter::addMember(const std::string& name, const char* data,
+                              std::uint64_t size) {
+    if (name.empty() || name.size() > UINT16_MAX) {
+        throw std::invalid_argument("Invalid member name");
+    }
+    // Extraction would write both to the same file
+    if (m_names.count(name) != 0) {
+        throw std::invalid_argument("Duplicate member name " + name);
+    }
+
+    if (!m_headerWritten) {
+        writeHeader();
+    }
+
+    Entry entry;
+    entry.name         = name;
+    entry.method       = ArchiveFormat::STORED;
+    entry.originalSize = size;
+    entry.offset       = m_offset;
+
+    std::uint64_t written = 0;
+    if (size > 0 && m_shared && size <= m_sharedMaxMember &&
+        isCovered(data, size)) {
+        written      = compressShared(size);
+        entry.method = ArchiveFormat::SHARED;
+    } else if (size > 0) {
+        written      = compressBlocks(data, size);
+        entry.method = ArchiveFormat::BLOCKS;
+    }
+
+    if (entry.method == ArchiveFormat::SHARED && written != 0) {
+        // The coder went over the whole member and computed it on the way
+        entry.checksum = m_coder.getChecksum();
+    } else {
+        entry.checksum = Kernels::get().crc32c(
+            0, reinterpret_cast<const unsigned char*>(data), size);
+    }
+
+    if (written == 0) {
+        entry.method = ArchiveFormat::STORED;
+        write(data, size);
+        written = size;
+    } else {
+        write(m_buffer.data(), written);
+    }
+
+    entry.compressedSize = written;
+    m_offset += written;
+    m_entries.push_back(entry);
+    m_names.insert(name);
+}
+
+void ArchiveWriter::copyMember(const ArchiveReader& reader,
+                               const ArchiveReader::Member& member) {
+    if (member.method == ArchiveFormat::SHARED) {
+        // Canonical codes are equal when their lengths are
+        const Code* codes = reader.getSharedCodes();
+        bool same         = m_shared && codes != nullptr;
+        for (int i = 0; same && i < FREQ_SIZE; i++) {
+            same = codes[i].length == m_codes[i].length;
+        }
+
+        if (!same) {
+            throw std::runtime_error("Member " + member.name +
+                                     " uses other shared codes");
+        }
+    }
+    if (m_names.count(member.name) != 0) {
+        throw std::runtime_error("Duplicate member name " + member.name);
+    }
+
+    if (!m_headerWritten) {
+        writeHeader();
+    }
+
+    Entry entry;
+    entry.name           = member.name;
+    entry.method         = member.method;
+    entry.originalSize   = member.originalSize;
+    entry.compressedSize = member.compressedSize;
+    entry.offset         = m_offset;
+    entry.checksum       = member.checksum;
+    write(reader.getMemberData(member), member.compressedSize);
+
+    m_offset += member.compressedSize;
+    m_entries.push_back(entry);
+    m_names.insert(member.name);
+}
+
+void ArchiveWriter::finish() {
+    if (!m_headerWritten) {
+        writeHeader();
+    }
+
+    const std::uint64_t directoryOffset = m_offset;
+    char fields[ArchiveFormat::ENTRY_SIZE];
+    for (const Entry& entry : m_entries) {
+        writeLE16(fields, static_cast<std::uint16_t>(entry.name.size()));
+        write(fields, 2);
+        write(entry.name.data(), entry.name.size());
+
+        fields[0] = static_cast<char>(entry.method);
+        writeLE64(fields + 1, entry.originalSize);
+        writeLE64(fields + 9, entry.compressedSize);
+        writeLE64(fields + 17, entry.offset);
+        writeLE32(fields + 25, entry.checksum);
+        write(fields, ArchiveFormat::ENTRY_SIZE - 2);
+        m_offset += ArchiveFormat::ENTRY_SIZE + entry.name.size();
+    }
+
+    char trailer[ArchiveFormat::TRAILER_SIZE];
+    writeLE64(trailer, directoryOffset);
+    writeLE64(trailer + 8, m_offset - directoryOffset);
+    writeLE32(trailer + 16, static_cast<std::uint32_t>(m_entries.size()));
+    std::memcpy(trailer + 20, ArchiveFormat::END_MAGIC,
+                sizeof(ArchiveFormat::END_MAGIC));
+    write(trailer, ArchiveFormat::TRAILER_SIZE);
+    m_offset += ArchiveFormat::TRAILER_SIZE;
+
+    if (m_file != nullptr) {
+        m_file->finish();
+        return;
+    }
+    m_stream->flush();
+    if (!*m_stream) {
+        throw std::runtime_error("Unable to write archive");
+    }
+}
+
+void ArchiveWriter::write(const char* data, std::uint64_t size) {
+    if (m_file != nullptr) {
+        m_file->write(data, size);
+    } else {
+        m_stream->write(data, static_cast<std::streamsize>(size));
+    }
+}
+
+void ArchiveWriter::writeHeader() {
+    char header[ArchiveFormat::HEADER_SIZE];
+    std::memcpy(header, ArchiveFormat::MAGIC, sizeof(ArchiveFormat::MAGIC));
+    header[8] = static_cast<char>(ArchiveFormat::VERSION);
+    header[9] = static_cast<char>(m_shared ? ArchiveFormat::SHARED_TABLE : 0);
+    write(header, ArchiveFormat::HEADER_SIZE);
+    m_offset += ArchiveFormat::HEADER_SIZE;
+
+    if (m_shared) {
+        // Code lengths only, the codes are canonical
+        std::uint16_t symbols = 0;
+        for (const auto& code : m_codes) {
+            symbols += code.length != 0 ? 1 : 0;
+        }
+
+        char fields[2];
+        writeLE16(fields, symbols);
+        write(fields, 2);
+        for (int i = 0; i < FREQ_SIZE; i++) {
+            if (m_codes[i].length != 0) {
+                fields[0] = static_cast<char>(i);
+                fields[1] = static_cast<char>(m_codes[i].length);
+                write(fields, 2);
+            }
+        }
+        m_offset += 2 + symbols * 2;
+    }
+
+    m_headerWritten = true;
+}
+
+bool ArchiveWriter::isCovered(const char* data, std::uint64_t size) {
+    m_coder.reset(data, size);
+    const std::uint64_t* frequencies = m_coder.getFrequencies();
+    for (int i = 0; i < FREQ_SIZE; i++) {
+        if (frequencies[i] != 0 && m_codes[i].length == 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+std::uint64_t ArchiveWriter::compressBlocks(const char* data,
+                                            std::uint64_t size) {
+    m_blocks.reset(data, size);
+    m_buffer.clear();
+
+    std::uint64_t written = 0;
+    std::int64_t chunk    = 0;
+    while (written < size) {
+        m_buffer.resize(written + BlockCoder::MAX_OUTPUT);
+        chunk = m_blocks.compress(m_buffer.data() + written,
+                                  BlockCoder::MAX_OUTPUT);
+        if (chunk < 0) {
+            break;
+        }
+
+        written += chunk;
+    }
+
+    return chunk < 0 && written < size ? written : 0;
+}
+
+std::uint64_t ArchiveWriter::compressShared(std::uint64_t size) {
+    // Room for the stream header and the final word, so the coder always
+    // takes some input while the stream is smaller than the member
+    const std::uint64_t limit = size + HuffmanCoder::MAX_HEADER_SIZE + BYTES;
+    m_buffer.resize(limit);
+
+    std::uint64_t written = 0;
+    std::int64_t chunk    = 0;
+    while (written < size) {
+        chunk = m_coder.compress(m_buffer.data() + written, limit - written);
+        if (chunk < 0) {
+            break;
+        }
+
+        written += chunk;
+    }
+
+    if (chunk >= 0) {
+        return 0; // Stopped before the end, the member does not shrink
+    }
+
+    if (chunk == -2) {
+        written += m_coder.getLastBytes();
+    }
+
+    return written < size ? written : 0;
+}
+
+}
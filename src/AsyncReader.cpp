@@ -0,0 +1,191 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <AsyncReader.hpp>
+#include <algorithm>
+#include <filesystem>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <cerrno>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+namespace hfm {
+
+AsyncReader::AsyncReader(const char* path)
+    : AsyncReader(path, IoBackend::create(DEPTH)) {
+}
+
+AsyncReader::AsyncReader(const char* path, std::unique_ptr<IoBackend> backend)
+    : m_path(path), m_backend(std::move(backend)), m_fd(-1), m_direct(false),
+      m_size(0), m_buffers(nullptr), m_slots(), m_nextOffset(0),
+      m_inFlight(0), m_current(0), m_holding(false) {
+    std::error_code error;
+    m_size = std::filesystem::file_size(path, error);
+    if (error) {
+        throw std::runtime_error("Unable to open " + m_path);
+    }
+
+    if (!m_backend) {
+        m_stream.open(path, std::ios::binary);
+        if (!m_stream) {
+            throw std::runtime_error("Unable to open " + m_path);
+        }
+    }
+#if defined(__unix__) || defined(__APPLE__)
+    else {
+    #ifdef O_DIRECT
+        if (IoBackend::isDirectWanted(m_size)) {
+            m_fd     = open(path, O_RDONLY | O_DIRECT);
+            m_direct = m_fd >= 0;
+        }
+    #endif
+        if (m_fd < 0) {
+            m_fd = open(path, O_RDONLY);
+        }
+        if (m_fd < 0) {
+            throw std::runtime_error("Unable to open " + m_path + ": " +
+                                     std::strerror(errno));
+        }
+    }
+#endif
+
+    m_buffers = static_cast<char*>(operator new(
+        DEPTH * BUFFER_SIZE, std::align_val_t(IoBackend::ALIGNMENT)));
+    if (m_backend) {
+        for (unsigned int i = 0; i < DEPTH && m_nextOffset < m_size; i++) {
+            submit(i);
+        }
+        m_backend->flush();
+    }
+}
+
+AsyncReader::~AsyncReader() {
+    // The backend may still be reading into the buffers
+    while (m_inFlight > 0) {
+        m_backend->wait();
+        m_inFlight--;
+    }
+#if defined(__unix__) || defined(__APPLE__)
+    if (m_fd >= 0) {
+        close(m_fd);
+    }
+#endif
+    operator delete(m_buffers, std::align_val_t(IoBackend::ALIGNMENT));
+}
+
+std::uint64_t AsyncReader::getSize() const {
+    return m_size;
+}
+
+std::uint64_t AsyncReader::next(const char*& data) {
+    if (!m_backend) {
+        m_stream.read(m_buffers, BUFFER_SIZE);
+        if (m_stream.bad()) {
+            throw std::runtime_error("Unable to read " + m_path);
+        }
+
+        data = m_buffers;
+        return static_cast<std::uint64_t>(m_stream.gcount());
+    }
+
+    // The part returned last time is done with, so its buffer can take the
+    // next read
+    if (m_holding) {
+        unsigned int previous   = (m_current + DEPTH - 1) % DEPTH;
+        m_slots[previous].used  = false;
+        m_holding               = false;
+        if (m_nextOffset < m_size) {
+            submit(previous);
+            m_backend->flush();
+        }
+    }
+
+    Slot& slot = m_slots[m_current];
+    if (!slot.used) {
+        return 0;
+    }
+
+    waitFor(m_current);
+    data      = m_buffers + m_current * BUFFER_SIZE;
+    m_current = (m_current + 1) % DEPTH;
+    m_holding = true;
+
+    return slot.size;
+}
+
+void AsyncReader::submit(unsigned int slot) {
+    Slot& part  = m_slots[slot];
+    part.offset = m_nextOffset;
+    part.size   = std::min(BUFFER_SIZE, m_size - m_nextOffset);
+    part.done   = 0;
+    part.used   = true;
+    m_nextOffset += part.size;
+    submitRest(slot);
+}
+
+void AsyncReader::submitRest(unsigned int slot) {
+    Slot& part = m_slots[slot];
+    if (m_direct) {
+        // O_DIRECT takes aligned offsets only, so after a short read the
+        // block it stopped in is read again from its start
+        part.done &= ~(IoBackend::ALIGNMENT - 1);
+    }
+    std::uint64_t size = part.size - part.done;
+    if (m_direct) {
+        // The last part of the file is read with a whole aligned block
+        size = (size + IoBackend::ALIGNMENT - 1) & ~(IoBackend::ALIGNMENT - 1);
+    }
+
+    IoBackend::Request request;
+    request.fd     = m_fd;
+    request.buffer = m_buffers + slot * BUFFER_SIZE + part.done;
+    request.size   = size;
+    request.offset = part.offset + part.done;
+    request.write  = false;
+    request.tag    = slot;
+    m_backend->submit(request);
+    m_inFlight++;
+}
+
+void AsyncReader::waitFor(unsigned int slot) {
+    // Reads can finish in any order, so completions of other parts are
+    // recorded on the way
+    while (m_slots[slot].done < m_slots[slot].size) {
+        IoBackend::Completion completion = m_backend->wait();
+        m_inFlight--;
+        if (completion.result < 0) {
+            throw std::runtime_error(
+                "Unable to read " + m_path + ": " +
+                std::strerror(static_cast<int>(-completion.result)));
+        }
+        if (completion.result == 0) {
+            throw std::runtime_error("Unexpected end of " + m_path);
+        }
+
+        Slot& part = m_slots[completion.tag];
+        part.done  = std::min(part.size, part.done + completion.result);
+        if (part.done < part.size) {
+            submitRest(static_cast<unsigned int>(completion.tag));
+            m_backend->flush();
+        }
+    }
+}
+
+}
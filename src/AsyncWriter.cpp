@@ -0,0 +1,224 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <AsyncWriter.hpp>
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <cerrno>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+namespace {
+
+// Full buffers are handed to the backend in pairs, one system call each
+constexpr unsigned int WRITE_BATCH = 2;
+
+}
+
+namespace hfm {
+
+AsyncWriter::AsyncWriter(const char* path, std::uint64_t expectedSize)
+    : AsyncWriter(path, expectedSize, IoBackend::create(DEPTH)) {
+}
+
+AsyncWriter::AsyncWriter(const char* path, std::uint64_t expectedSize,
+                         std::unique_ptr<IoBackend> backend)
+    : m_path(path), m_backend(std::move(backend)), m_fd(-1), m_direct(false),
+      m_buffers(nullptr), m_slots(), m_current(0), m_fill(0), m_offset(0),
+      m_inFlight(0), m_unflushed(0), m_finished(false) {
+    if (!m_backend) {
+        m_stream.open(path, std::ios::binary);
+        if (!m_stream) {
+            throw std::runtime_error("Unable to open " + m_path);
+        }
+    }
+#if defined(__unix__) || defined(__APPLE__)
+    else {
+        const int flags = O_WRONLY | O_CREAT | O_TRUNC;
+    #ifdef O_DIRECT
+        if (IoBackend::isDirectWanted(expectedSize)) {
+            m_fd     = open(path, flags | O_DIRECT, 0666);
+            m_direct = m_fd >= 0;
+        }
+    #endif
+        if (m_fd < 0) {
+            m_fd = open(path, flags, 0666);
+        }
+        if (m_fd < 0) {
+            throw std::runtime_error("Unable to open " + m_path + ": " +
+                                     std::strerror(errno));
+        }
+    }
+#endif
+    (void)expectedSize;
+
+    m_buffers = static_cast<char*>(operator new(
+        DEPTH * BUFFER_SIZE, std::align_val_t(IoBackend::ALIGNMENT)));
+}
+
+AsyncWriter::~AsyncWriter() {
+    try {
+        finish();
+    } catch (const std::exception&) {
+    }
+    // finish() may have thrown with writes still running
+    while (m_inFlight > 0) {
+        m_backend->wait();
+        m_inFlight--;
+    }
+#if defined(__unix__) || defined(__APPLE__)
+    if (m_fd >= 0) {
+        close(m_fd);
+    }
+#endif
+    operator delete(m_buffers, std::align_val_t(IoBackend::ALIGNMENT));
+}
+
+void AsyncWriter::write(const char* data, std::uint64_t size) {
+    if (!m_backend) {
+        m_stream.write(data, static_cast<std::streamsize>(size));
+        if (!m_stream) {
+            throw std::runtime_error("Unable to write " + m_path);
+        }
+        return;
+    }
+
+    while (size > 0) {
+        const std::uint64_t count = std::min(size, BUFFER_SIZE - m_fill);
+        std::copy(data, data + count,
+                  m_buffers + m_current * BUFFER_SIZE + m_fill);
+        m_fill += count;
+        data += count;
+        size -= count;
+
+        if (m_fill == BUFFER_SIZE) {
+            Slot& slot  = m_slots[m_current];
+            slot.offset = m_offset;
+            slot.size   = BUFFER_SIZE;
+            slot.done   = 0;
+            submit(m_current);
+            m_offset += BUFFER_SIZE;
+            m_fill    = 0;
+            m_current = (m_current + 1) % DEPTH;
+            if (m_unflushed >= WRITE_BATCH) {
+                m_backend->flush();
+                m_unflushed = 0;
+            }
+            while (m_slots[m_current].busy) {
+                reap();
+            }
+        }
+    }
+}
+
+void AsyncWriter::finish() {
+    if (m_finished) {
+        return;
+    }
+    m_finished = true;
+
+    if (!m_backend) {
+        m_stream.close();
+        if (!m_stream) {
+            throw std::runtime_error("Unable to write " + m_path);
+        }
+        return;
+    }
+
+    const std::uint64_t end = m_offset + m_fill;
+    if (m_fill > 0) {
+        Slot& slot  = m_slots[m_current];
+        slot.offset = m_offset;
+        slot.size   = m_fill;
+        slot.done   = 0;
+        if (m_direct) {
+            // O_DIRECT only writes whole blocks; the padding is cut off below
+            slot.size = (m_fill + IoBackend::ALIGNMENT - 1) &
+                        ~(IoBackend::ALIGNMENT - 1);
+            std::fill(m_buffers + m_current * BUFFER_SIZE + m_fill,
+                      m_buffers + m_current * BUFFER_SIZE + slot.size, 0);
+        }
+        submit(m_current);
+    }
+    while (m_inFlight > 0) {
+        reap();
+    }
+
+#if defined(__unix__) || defined(__APPLE__)
+    if (m_direct && ftruncate(m_fd, static_cast<off_t>(end)) != 0) {
+        fail(errno);
+    }
+    const int result = close(m_fd);
+    m_fd             = -1;
+    if (result != 0) {
+        fail(errno);
+    }
+#endif
+    (void)end;
+}
+
+void AsyncWriter::submit(unsigned int slot) {
+    Slot& part = m_slots[slot];
+    if (m_direct) {
+        // O_DIRECT takes aligned offsets only, so after a short write the
+        // block it stopped in is written again from its start
+        part.done &= ~(IoBackend::ALIGNMENT - 1);
+    }
+
+    IoBackend::Request request;
+    request.fd     = m_fd;
+    request.buffer = m_buffers + slot * BUFFER_SIZE + part.done;
+    request.size   = part.size - part.done;
+    request.offset = part.offset + part.done;
+    request.write  = true;
+    request.tag    = slot;
+    m_backend->submit(request);
+    part.busy = true;
+    m_inFlight++;
+    m_unflushed++;
+}
+
+void AsyncWriter::reap() {
+    IoBackend::Completion completion = m_backend->wait();
+    m_inFlight--;
+    m_unflushed = 0; // wait() flushed the queue
+    if (completion.result <= 0) {
+        m_slots[completion.tag].busy = false;
+        fail(completion.result < 0 ? static_cast<int>(-completion.result)
+                                   : ENOSPC);
+    }
+
+    Slot& slot = m_slots[completion.tag];
+    slot.done += static_cast<std::uint64_t>(completion.result);
+    if (slot.done < slot.size) {
+        submit(static_cast<unsigned int>(completion.tag));
+        m_backend->flush();
+        m_unflushed = 0;
+    } else {
+        slot.busy = false;
+    }
+}
+
+void AsyncWriter::fail(int error) {
+    throw std::runtime_error("Unable to write " + m_path + ": " +
+                             std::strerror(error));
+}
+
+}
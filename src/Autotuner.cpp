@@ -0,0 +1,209 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <Autotuner.hpp>
+#include <BlockCoder.hpp>
+#include <BlockDecoder.hpp>
+#include <JobPool.hpp>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+constexpr std::uint64_t BLOCK_SIZES[]   = {128 << 10, 256 << 10, 512 << 10,
+                                           1 << 20};
+constexpr std::uint64_t SEGMENT_SIZES[] = {1 << 20, 2 << 20, 4 << 20,
+                                           8 << 20, 16 << 20};
+
+double getSeconds() {
+    return std::chrono::duration<double>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+}
+
+namespace hfm {
+
+Autotuner::Autotuner(std::ostream& log) : m_log(log) {}
+
+Profile Autotuner::run(const char* data, std::uint64_t size) {
+    const std::vector<char> sample = takeSample(data, size);
+    m_log << "Sample: " << sample.size() << " bytes" << std::endl;
+
+    Profile profile;
+    std::vector<Result> results;
+    for (std::uint64_t blockSize : BLOCK_SIZES) {
+        m_log << "Block size " << blockSize << ": ";
+        results.push_back(measureBlocks(sample, blockSize));
+        report(sample, results.back());
+    }
+    profile.maxBlockSize = BLOCK_SIZES[pick(results)];
+
+    // Powers of two up to the number of cores, and that number itself
+    std::vector<unsigned int> threads;
+    const unsigned int cores =
+        std::max(std::thread::hardware_concurrency(), 1u);
+    for (unsigned int count = 1; count < cores; count *= 2) {
+        threads.push_back(count);
+    }
+    threads.push_back(cores);
+
+    std::vector<unsigned int> candidateThreads;
+    std::vector<std::uint64_t> candidateSegments;
+    results.clear();
+    for (unsigned int count : threads) {
+        for (std::uint64_t segmentSize : SEGMENT_SIZES) {
+            m_log << "Threads " << count << ", segment size " << segmentSize
+                  << ": ";
+            results.push_back(measurePool(sample, count, segmentSize,
+                                          profile.maxBlockSize));
+            report(sample, results.back());
+            candidateThreads.push_back(count);
+            candidateSegments.push_back(segmentSize);
+
+            // Larger segments than the sample all give the same work
+            if (segmentSize >= sample.size()) {
+                break;
+            }
+        }
+    }
+
+    const std::size_t best = pick(results);
+    profile.threads        = candidateThreads[best];
+    profile.segmentSize    = candidateSegments[best];
+
+    return profile;
+}
+
+std::vector<char> Autotuner::takeSample(const char* data,
+                                        std::uint64_t size) {
+    if (size <= MAX_SAMPLE) {
+        return std::vector<char>(data, data + size);
+    }
+
+    // Spread over the input, which may change its kind along the way
+    std::vector<char> sample;
+    sample.reserve(MAX_SAMPLE);
+    const std::uint64_t part = MAX_SAMPLE / SAMPLE_PARTS;
+    for (int i = 0; i < SAMPLE_PARTS; i++) {
+        const std::uint64_t offset = (size - part) / (SAMPLE_PARTS - 1) * i;
+        sample.insert(sample.end(), data + offset, data + offset + part);
+    }
+
+    return sample;
+}
+
+Autotuner::Result Autotuner::measureBlocks(const std::vector<char>& sample,
+                                           std::uint64_t maxBlockSize) {
+    Result result = {0, 0};
+    BlockCoder coder(nullptr, 0);
+    coder.setMaxBlockSize(maxBlockSize);
+    std::vector<char> stream;
+    std::vector<char> output(BlockFormat::MAX_BLOCK_SIZE);
+
+    for (int run = 0; run < RUNS; run++) {
+        const double start = getSeconds();
+
+        coder.reset(sample.data(), sample.size());
+        std::uint64_t written = 0;
+        std::int64_t chunk    = 0;
+        for (;;) {
+            stream.resize(written + BlockCoder::MAX_OUTPUT);
+            chunk = coder.compress(stream.data() + written,
+                                   BlockCoder::MAX_OUTPUT);
+            if (chunk < 0) {
+                break;
+            }
+
+            written += chunk;
+        }
+
+        BlockDecoder decoder(stream.data(), written);
+        while (decoder.decompress(output.data(), output.size()) >= 0) {
+        }
+
+        const double seconds = getSeconds() - start;
+        if (run == 0 || seconds < result.seconds) {
+            result.seconds = seconds;
+        }
+        result.size = written;
+    }
+
+    return result;
+}
+
+Autotuner::Result Autotuner::measurePool(const std::vector<char>& sample,
+                                         unsigned int threads,
+                                         std::uint64_t segmentSize,
+                                         std::uint64_t maxBlockSize) {
+    Result result = {0, 0};
+    JobPool pool(threads, 1);
+    pool.setSegmentSize(segmentSize);
+    pool.setMaxBlockSize(maxBlockSize);
+
+    for (int run = 0; run < RUNS; run++) {
+        const double start = getSeconds();
+
+        std::vector<char> stream =
+            pool.submit(JobPool::COMPRESS, sample).get();
+        const std::uint64_t written = stream.size();
+        std::vector<char> output =
+            pool.submit(JobPool::DECOMPRESS, std::move(stream)).get();
+
+        const double seconds = getSeconds() - start;
+        if (output != sample) {
+            throw std::runtime_error("Calibration round trip failed");
+        }
+        if (run == 0 || seconds < result.seconds) {
+            result.seconds = seconds;
+        }
+        result.size = written;
+    }
+
+    return result;
+}
+
+void Autotuner::report(const std::vector<char>& sample, const Result& result) {
+    const double megabytes = sample.size() / 1e6;
+    m_log << (result.seconds > 0 ? megabytes / result.seconds : 0)
+          << " MB/s, " << result.size << " bytes" << std::endl;
+}
+
+std::size_t Autotuner::pick(const std::vector<Result>& results) {
+    double fastest = results[0].seconds;
+    for (const Result& result : results) {
+        fastest = std::min(fastest, result.seconds);
+    }
+
+    std::size_t best = results.size();
+    for (std::size_t i = 0; i < results.size(); i++) {
+        const Result& result = results[i];
+        if (result.seconds > fastest * (1 + SLOWDOWN)) {
+            continue;
+        }
+
+        if (best == results.size() || result.size < results[best].size ||
+            (result.size == results[best].size &&
+             result.seconds < results[best].seconds)) {
+            best = i;
+        }
+    }
+
+    return best;
+}
+
+}
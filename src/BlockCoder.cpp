@@ -0,0 +1,206 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <BlockCoder.hpp>
+#include <ContextPool.hpp>
+#include <ByteOrder.hpp>
+#include <Kernels.hpp>
+#include <stdexcept>
+#include <cstring>
+
+namespace {
+
+constexpr int BYTES = 8;
+
+}
+
+namespace hfm {
+
+BlockCoder::BlockCoder(const char* inBuff, std::uint64_t buffSize)
+    : m_inBuff(inBuff), m_buffSize(buffSize), m_blocksReady(false),
+      m_checksum(true), m_maxBlockSize(BlockFormat::MAX_BLOCK_SIZE),
+      m_headerWritten(false), m_endWritten(false), m_nextBlock(0),
+      m_offset(0) {}
+
+void BlockCoder::reset(const char* inBuff, std::uint64_t buffSize) {
+    m_inBuff        = inBuff;
+    m_buffSize      = buffSize;
+    m_blocksReady   = false;
+    m_headerWritten = false;
+    m_endWritten    = false;
+    m_nextBlock     = 0;
+    m_offset        = 0;
+}
+
+void BlockCoder::setChecksum(bool enabled) {
+    m_checksum = enabled;
+}
+
+void BlockCoder::setMaxBlockSize(std::uint64_t size) {
+    if (size < BlockSplitter::SEGMENT_SIZE ||
+        size > BlockFormat::MAX_BLOCK_SIZE) {
+        throw std::invalid_argument("Invalid block size");
+    }
+
+    m_maxBlockSize = size;
+    m_blocksReady  = false;
+}
+
+const std::vector<std::uint64_t>& BlockCoder::getBlocks() {
+    if (!m_blocksReady) {
+        m_blocks = m_splitter.split(m_inBuff, m_buffSize, m_maxBlockSize);
+        m_blocksReady = true;
+    }
+
+    return m_blocks;
+}
+
+std::int64_t BlockCoder::compress(char* outBuff, std::uint64_t numBytes) {
+    if (m_endWritten) {
+        return -1; // Signal end of buffer
+    }
+
+    if (numBytes < MAX_OUTPUT) {
+        throw std::length_error("Output buffer too small");
+    }
+
+    const std::vector<std::uint64_t>& blocks = getBlocks();
+    std::uint64_t bytesWrote = 0;
+
+    if (!m_headerWritten) {
+        std::memcpy(outBuff, BlockFormat::MAGIC, sizeof(BlockFormat::MAGIC));
+        outBuff[8]      = static_cast<char>(BlockFormat::VERSION);
+        outBuff[9]      = 0; // Flags
+        bytesWrote      = BlockFormat::HEADER_SIZE;
+        m_headerWritten = true;
+    }
+
+    if (m_nextBlock < blocks.size()) {
+        std::uint64_t size = blocks[m_nextBlock++];
+        bytesWrote +=
+            writeBlock(outBuff + bytesWrote, m_inBuff + m_offset, size);
+        m_offset += size;
+
+        return bytesWrote;
+    }
+
+    outBuff[bytesWrote]     = static_cast<char>(BlockFormat::END);
+    outBuff[bytesWrote + 1] = 0; // Flags
+    writeLE64(outBuff + bytesWrote + 2, m_buffSize);
+    bytesWrote += BlockFormat::END_SIZE;
+    m_endWritten = true;
+
+    return bytesWrote;
+}
+
+std::uint64_t BlockCoder::writeBlock(char* outBuff, const char* block,
+                                     std::uint64_t size) {
+    // The data is coded after the transform expected to help it most
+    Transform::Type transform = Transform::choose(block, size);
+    const char* data          = block;
+    std::uint64_t dataSize    = size;
+    if (transform != Transform::NONE) {
+        const Transform* stage = Transform::get(transform);
+        m_transformed.resize(stage->getMaxOutput(size));
+        dataSize = stage->forward(block, size, m_transformed.data());
+        data     = m_transformed.data();
+    }
+
+    std::uint64_t headerSize = BlockFormat::BLOCK_HEADER_SIZE +
+                               (m_checksum ? BlockFormat::CHECKSUM_SIZE : 0);
+    char* payload = outBuff + headerSize +
+                    (transform != Transform::NONE ? BlockFormat::TRANSFORM_SIZE
+                                                  : 0);
+
+    // Both coders use the histogram of the Huffman coder, and the one with
+    // the smaller expected output is used. The checksum covers the original
+    // data, so it is only fused with coding when there is no transform.
+    HuffmanCoder& coder = ContextPool::getCoder(data, dataSize);
+    coder.setChecksum(m_checksum && transform == Transform::NONE);
+    m_rans.setFrequencies(coder.getFrequencies());
+
+    BlockFormat::Method method = BlockFormat::STORED;
+    std::uint64_t payloadSize  = 0;
+    std::uint32_t crc          = 0;
+    if (m_rans.estimateSize() < coder.getCompressedSize()) {
+        payloadSize = m_rans.compress(data, dataSize, payload, size);
+        method      = BlockFormat::RANS;
+    } else {
+        payloadSize = writeHuffman(payload, size, coder);
+        method      = BlockFormat::HUFFMAN;
+        crc         = coder.getChecksum();
+    }
+
+    if (payloadSize == 0 || payloadSize >= size) {
+        // Coding does not pay off, keep the original bytes
+        method      = BlockFormat::STORED;
+        transform   = Transform::NONE;
+        payloadSize = size;
+        payload     = outBuff + headerSize;
+        std::memcpy(payload, block, size);
+    }
+
+    if (m_checksum &&
+        (method != BlockFormat::HUFFMAN || transform != Transform::NONE)) {
+        crc = Kernels::get().crc32c(
+            0, reinterpret_cast<const unsigned char*>(block), size);
+    }
+
+    outBuff[0] = static_cast<char>(method);
+    outBuff[1] = static_cast<char>(
+        (m_checksum ? BlockFormat::CHECKSUM : 0) |
+        (transform << BlockFormat::TRANSFORM_SHIFT));
+    writeLE32(outBuff + 2, static_cast<std::uint32_t>(size));
+    writeLE32(outBuff + 6, static_cast<std::uint32_t>(payloadSize));
+    if (m_checksum) {
+        writeLE32(outBuff + BlockFormat::BLOCK_HEADER_SIZE, crc);
+    }
+
+    if (transform != Transform::NONE) {
+        writeLE32(outBuff + headerSize, static_cast<std::uint32_t>(dataSize));
+        headerSize += BlockFormat::TRANSFORM_SIZE;
+    }
+
+    return headerSize + payloadSize;
+}
+
+std::uint64_t BlockCoder::writeHuffman(char* payload, std::uint64_t size,
+                                       HuffmanCoder& coder) {
+    // Room for the stream header and the final word, so the coder always
+    // takes some input while the payload is smaller than the block
+    const std::uint64_t limit = size + HuffmanCoder::MAX_HEADER_SIZE + BYTES;
+
+    std::uint64_t payloadSize = 0;
+    std::int64_t written      = 0;
+    while (payloadSize < size) {
+        written = coder.compress(payload + payloadSize, limit - payloadSize);
+        if (written < 0) {
+            break;
+        }
+
+        payloadSize += written;
+    }
+
+    if (written >= 0) {
+        return 0; // Stopped before the end, the block does not shrink
+    }
+
+    if (written == -2) {
+        payloadSize += coder.getLastBytes();
+    }
+
+    return payloadSize;
+}
+
+}
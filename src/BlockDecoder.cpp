@@ -0,0 +1,337 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <BlockDecoder.hpp>
+#include <ContextPool.hpp>
+#include <ByteOrder.hpp>
+#include <Kernels.hpp>
+#include <RansDecoder.hpp>
+#include <Transform.hpp>
+#include <stdexcept>
+#include <cstring>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <algorithm>
+
+namespace {
+
+// Output is checksummed in pieces small enough to still be in the L1 cache
+constexpr std::uint64_t CHECKSUM_CHUNK = 16 << 10;
+
+}
+
+namespace hfm {
+
+BlockDecoder::BlockDecoder(const char* inBuff, std::uint64_t buffSize)
+    : m_inBuff(inBuff), m_inBuffSize(buffSize), m_blocksRead(false),
+      m_originalSize(0), m_nextBlock(0) {}
+
+void BlockDecoder::reset(const char* inBuff, std::uint64_t buffSize) {
+    m_inBuff       = inBuff;
+    m_inBuffSize   = buffSize;
+    m_blocksRead   = false;
+    m_originalSize = 0;
+    m_nextBlock    = 0;
+    m_blocks.clear();
+}
+
+const std::vector<BlockDecoder::Block>& BlockDecoder::getBlocks() {
+    if (!m_blocksRead) {
+        readBlocks();
+    }
+
+    return m_blocks;
+}
+
+std::uint64_t BlockDecoder::getOriginalSize() {
+    if (!m_blocksRead) {
+        readBlocks();
+    }
+
+    return m_originalSize;
+}
+
+std::int64_t BlockDecoder::decompress(char* outBuff, std::uint64_t numBytes) {
+    const std::vector<Block>& blocks = getBlocks();
+
+    if (m_nextBlock == blocks.size()) {
+        return -1; // Signal end of buffer
+    }
+
+    const Block& block = blocks[m_nextBlock];
+    if (numBytes < block.originalSize) {
+        throw std::length_error("Output buffer too small");
+    }
+
+    decodeBlock(m_inBuff, block, outBuff,
+                ContextPool::getDecoder(nullptr, 0));
+    m_nextBlock++;
+
+    return block.originalSize;
+}
+
+std::uint64_t BlockDecoder::verify(unsigned int threads) {
+    const std::vector<Block>& blocks = getBlocks();
+    std::atomic<std::uint64_t> next(0);
+    std::atomic<bool> failed(false);
+    std::exception_ptr error;
+    std::mutex errorMutex;
+
+    // Workers take the next block until all are done or one has failed
+    auto worker = [&]() {
+        std::unique_ptr<char[]> sink(new char[BlockFormat::MAX_BLOCK_SIZE]);
+        HuffmanDecoder& decoder = ContextPool::getDecoder(nullptr, 0);
+
+        for (std::uint64_t i = next++; i < blocks.size() && !failed;
+             i = next++) {
+            try {
+                decodeBlock(m_inBuff, blocks[i], sink.get(), decoder);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!failed) {
+                    error  = std::current_exception();
+                    failed = true;
+                }
+            }
+        }
+    };
+
+    if (threads > blocks.size()) {
+        threads = static_cast<unsigned int>(blocks.size());
+    }
+
+    std::vector<std::thread> pool;
+    for (unsigned int i = 1; i < threads; i++) {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    return m_originalSize;
+}
+
+void BlockDecoder::decodeBlock(const char* inBuff, const Block& block,
+                               char* outBuff, HuffmanDecoder& decoder) {
+    const char* payload = inBuff + block.payloadOffset;
+    const bool checksum = (block.flags & BlockFormat::CHECKSUM) != 0;
+
+    if (block.method == BlockFormat::STORED) {
+        if (checksum &&
+            Kernels::get().crc32c(
+                0, reinterpret_cast<const unsigned char*>(payload),
+                block.originalSize) != block.checksum) {
+            throw std::runtime_error("Block checksum mismatch");
+        }
+
+        std::memcpy(outBuff, payload, block.originalSize);
+        return;
+    }
+
+    const Transform* transform =
+        Transform::get(static_cast<Transform::Type>(block.transform));
+    if (transform == nullptr) {
+        if (block.method == BlockFormat::RANS) {
+            decodeRans(payload, block, outBuff, checksum);
+        } else {
+            decodeHuffman(payload, block, outBuff, decoder, checksum);
+        }
+        return;
+    }
+
+    // The payload decodes to the transformed data, which is undone into
+    // outBuff and only then checked
+    char* coded = ContextPool::getBuffer(block.codedSize);
+    if (block.method == BlockFormat::RANS) {
+        decodeRans(payload, block, coded, false);
+    } else {
+        decodeHuffman(payload, block, coded, decoder, false);
+    }
+    transform->inverse(coded, block.codedSize, outBuff, block.originalSize);
+
+    if (checksum &&
+        Kernels::get().crc32c(
+            0, reinterpret_cast<const unsigned char*>(outBuff),
+            block.originalSize) != block.checksum) {
+        throw std::runtime_error("Block checksum mismatch");
+    }
+}
+
+void BlockDecoder::decodeHuffman(const char* payload, const Block& block,
+                                 char* outBuff, HuffmanDecoder& decoder,
+                                 bool crc) {
+    decoder.reset(payload, block.payloadSize);
+    decoder.setChecksum(crc);
+    std::uint64_t done = 0;
+    while (done < block.codedSize) {
+        std::int64_t written =
+            decoder.decompress(outBuff + done, block.codedSize - done);
+        if (written == -2) {
+            written = decoder.getLastBytes();
+        }
+
+        if (written <= 0) {
+            break;
+        }
+
+        done += written;
+    }
+
+    if (done != block.codedSize) {
+        throw std::runtime_error("Block size does not match its stream");
+    }
+
+    if (crc && decoder.getChecksum() != block.checksum) {
+        throw std::runtime_error("Block checksum mismatch");
+    }
+}
+
+void BlockDecoder::decodeRans(const char* payload, const Block& block,
+                              char* outBuff, bool crc) {
+    // The table is rebuilt for every block anyway, so the decoder lives on
+    // the stack instead of in a pool
+    RansDecoder decoder;
+    decoder.reset(payload, block.payloadSize);
+
+    // Checksummed in pieces that are still in the L1 cache
+    Kernels::Crc32cFn crc32c = Kernels::get().crc32c;
+    std::uint32_t value      = 0;
+    for (std::uint64_t done = 0; done < block.codedSize;) {
+        std::uint64_t n = std::min(block.codedSize - done, CHECKSUM_CHUNK);
+        decoder.decompress(outBuff + done, n);
+        if (crc) {
+            value = crc32c(
+                value, reinterpret_cast<const unsigned char*>(outBuff + done),
+                n);
+        }
+        done += n;
+    }
+    decoder.finish();
+
+    if (crc && value != block.checksum) {
+        throw std::runtime_error("Block checksum mismatch");
+    }
+}
+
+void BlockDecoder::readBlocks() {
+    if (!BlockFormat::isContainer(m_inBuff, m_inBuffSize)) {
+        throw std::runtime_error("Not a block container");
+    }
+
+    const std::uint8_t version = static_cast<std::uint8_t>(m_inBuff[8]);
+    if (version == 0 || version > BlockFormat::VERSION) {
+        throw std::runtime_error("Unsupported container version");
+    }
+
+    m_blocks.clear();
+    std::uint64_t offset = BlockFormat::HEADER_SIZE;
+    std::uint64_t total  = 0;
+    while (true) {
+        if (offset == m_inBuffSize) {
+            throw std::runtime_error("Truncated container");
+        }
+
+        const char* header = m_inBuff + offset;
+        std::uint8_t method = static_cast<std::uint8_t>(header[0]);
+        if (method == BlockFormat::END) {
+            if (m_inBuffSize - offset < BlockFormat::END_SIZE) {
+                throw std::runtime_error("Truncated container");
+            }
+
+            if (readLE64(header + 2) != total) {
+                throw std::runtime_error("Container size does not match");
+            }
+            break;
+        }
+
+        if (method != BlockFormat::STORED && method != BlockFormat::HUFFMAN &&
+            method != BlockFormat::RANS) {
+            throw std::runtime_error("Unknown block method");
+        }
+
+        if (m_inBuffSize - offset < BlockFormat::BLOCK_HEADER_SIZE) {
+            throw std::runtime_error("Truncated container");
+        }
+
+        Block block;
+        block.method        = method;
+        block.flags         = static_cast<std::uint8_t>(header[1]);
+        block.originalSize  = readLE32(header + 2);
+        block.payloadSize   = readLE32(header + 6);
+        block.payloadOffset = offset + BlockFormat::BLOCK_HEADER_SIZE;
+        block.outputOffset  = total;
+        block.checksum      = 0;
+        block.transform     = (block.flags & BlockFormat::TRANSFORM_MASK) >>
+                              BlockFormat::TRANSFORM_SHIFT;
+        block.codedSize     = block.originalSize;
+
+        if ((block.flags & ~(BlockFormat::CHECKSUM |
+                             BlockFormat::TRANSFORM_MASK)) != 0 ||
+            (block.transform != Transform::NONE &&
+             method == BlockFormat::STORED)) {
+            throw std::runtime_error("Invalid block header");
+        }
+
+        if ((block.flags & BlockFormat::CHECKSUM) != 0) {
+            if (m_inBuffSize - block.payloadOffset <
+                BlockFormat::CHECKSUM_SIZE) {
+                throw std::runtime_error("Truncated container");
+            }
+
+            block.checksum = readLE32(m_inBuff + block.payloadOffset);
+            block.payloadOffset += BlockFormat::CHECKSUM_SIZE;
+        }
+
+        if (block.transform != Transform::NONE) {
+            if (m_inBuffSize - block.payloadOffset <
+                BlockFormat::TRANSFORM_SIZE) {
+                throw std::runtime_error("Truncated container");
+            }
+
+            block.codedSize = readLE32(m_inBuff + block.payloadOffset);
+            block.payloadOffset += BlockFormat::TRANSFORM_SIZE;
+        }
+
+        const Transform* transform =
+            Transform::get(static_cast<Transform::Type>(block.transform));
+        if (block.originalSize > BlockFormat::MAX_BLOCK_SIZE ||
+            (transform != nullptr &&
+             block.codedSize > transform->getMaxOutput(block.originalSize)) ||
+            (method == BlockFormat::STORED &&
+             block.payloadSize != block.originalSize)) {
+            throw std::runtime_error("Invalid block header");
+        }
+
+        if (m_inBuffSize - block.payloadOffset < block.payloadSize) {
+            throw std::runtime_error("Truncated container");
+        }
+
+        m_blocks.push_back(block);
+        offset = block.payloadOffset + block.payloadSize;
+        total += block.originalSize;
+    }
+
+    m_originalSize = total;
+    m_blocksRead   = true;
+}
+
+}
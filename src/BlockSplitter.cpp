@@ -0,0 +1,175 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <BlockSplitter.hpp>
+#include <BlockFormat.hpp>
+#include <Kernels.hpp>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+constexpr int FREQ_SIZE = 256;
+// Table entry: byte, code length and about one byte of code
+constexpr double TABLE_ENTRY_BITS = 3 * 8;
+constexpr double HEADER_BITS =
+    (hfm::BlockFormat::BLOCK_HEADER_SIZE + 8 + 2 + 8) * 8;
+
+void add(std::uint64_t* dest, const std::uint64_t* src) {
+    for (int i = 0; i < FREQ_SIZE; i++) {
+        dest[i] += src[i];
+    }
+}
+
+void subtract(std::uint64_t* dest, const std::uint64_t* src) {
+    for (int i = 0; i < FREQ_SIZE; i++) {
+        dest[i] -= src[i];
+    }
+}
+
+// Cost of coding a and b together with one table
+double mergedBits(const std::uint64_t* a, const std::uint64_t* b) {
+    std::uint64_t merged[FREQ_SIZE];
+    for (int i = 0; i < FREQ_SIZE; i++) {
+        merged[i] = a[i] + b[i];
+    }
+
+    return hfm::BlockSplitter::estimateBits(merged);
+}
+
+}
+
+namespace hfm {
+
+std::vector<std::uint64_t> BlockSplitter::split(const char* data,
+                                                std::uint64_t size,
+                                                std::uint64_t maxBlockSize) {
+    std::vector<std::uint64_t> blocks;
+    if (size == 0) {
+        return blocks;
+    }
+
+    if (maxBlockSize < SEGMENT_SIZE) {
+        throw std::invalid_argument("Invalid block size");
+    }
+
+    const std::uint64_t segmentCount = (size + SEGMENT_SIZE - 1) / SEGMENT_SIZE;
+    const std::uint64_t maxSegments  = maxBlockSize / SEGMENT_SIZE;
+
+    m_segments.assign(segmentCount * FREQ_SIZE, 0);
+    for (std::uint64_t i = 0; i < segmentCount; i++) {
+        std::uint64_t offset = i * SEGMENT_SIZE;
+        std::uint64_t length =
+            size - offset < SEGMENT_SIZE ? size - offset : SEGMENT_SIZE;
+        Kernels::get().histogram(
+            reinterpret_cast<const unsigned char*>(data) + offset, length,
+            &m_segments[i * FREQ_SIZE]);
+    }
+
+    auto segment = [this](std::uint64_t i) {
+        return &m_segments[i * FREQ_SIZE];
+    };
+
+    std::uint64_t block[FREQ_SIZE]  = {}; // Histogram of the current block
+    std::uint64_t window[FREQ_SIZE] = {}; // Histogram of the next segments
+    std::uint64_t blockStart        = 0;  // First segment of the block
+    std::uint64_t windowEnd         = 1;  // Segment after the window
+
+    add(block, segment(0));
+    for (std::uint64_t i = 1; i < segmentCount; i++) {
+        // Slide the window so it covers the segments after i - 1
+        while (windowEnd < segmentCount && windowEnd < i + WINDOW_SEGMENTS) {
+            add(window, segment(windowEnd++));
+        }
+
+        std::uint64_t boundary = segmentCount; // Segment starting a new block
+
+        if (i - blockStart >= maxSegments) {
+            boundary = i;
+        } else if (estimateBits(block) + estimateBits(window) <
+                   mergedBits(block, window)) {
+            // Find the split inside the window that costs the least
+            std::uint64_t head[FREQ_SIZE] = {};
+            std::uint64_t tail[FREQ_SIZE];
+            for (int s = 0; s < FREQ_SIZE; s++) {
+                tail[s] = window[s];
+            }
+
+            double best = -1;
+            for (std::uint64_t j = i; j < windowEnd; j++) {
+                double bits = mergedBits(block, head) + estimateBits(tail);
+                if (best < 0 || bits < best) {
+                    best     = bits;
+                    boundary = j;
+                }
+
+                add(head, segment(j));
+                subtract(tail, segment(j));
+            }
+
+            if (boundary - blockStart > maxSegments) {
+                boundary = blockStart + maxSegments;
+            }
+        }
+
+        if (boundary == segmentCount) {
+            add(block, segment(i));
+            subtract(window, segment(i));
+            continue;
+        }
+
+        // Everything before the boundary joins the block
+        for (; i < boundary; i++) {
+            add(block, segment(i));
+            subtract(window, segment(i));
+        }
+
+        blocks.push_back((boundary - blockStart) * SEGMENT_SIZE);
+        blockStart = boundary;
+        for (int s = 0; s < FREQ_SIZE; s++) {
+            block[s] = 0;
+        }
+        add(block, segment(boundary));
+        subtract(window, segment(boundary));
+    }
+
+    blocks.push_back(size - blockStart * SEGMENT_SIZE);
+    return blocks;
+}
+
+double BlockSplitter::estimateBits(const std::uint64_t* histogram) {
+    std::uint64_t total = 0;
+    int symbols         = 0;
+    for (int i = 0; i < FREQ_SIZE; i++) {
+        total += histogram[i];
+        symbols += histogram[i] != 0 ? 1 : 0;
+    }
+
+    if (total == 0) {
+        return 0;
+    }
+
+    // Shannon bound of the data; Huffman codes come close to it
+    double bits = 0;
+    for (int i = 0; i < FREQ_SIZE; i++) {
+        if (histogram[i] != 0) {
+            double count = static_cast<double>(histogram[i]);
+            bits += count * std::log2(static_cast<double>(total) / count);
+        }
+    }
+
+    return bits + symbols * TABLE_ENTRY_BITS + HEADER_BITS;
+}
+
+}
@@ -0,0 +1,173 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <CodeBuilder.hpp>
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+constexpr unsigned int BITS = 64;
+
+// Orders heap entries by weight, then by node number so that the generated
+// codes do not depend on the heap layout
+bool lighter(const std::uint64_t* weights, int a, int b) {
+    return weights[a] < weights[b] || (weights[a] == weights[b] && a < b);
+}
+
+void siftDown(int* heap, int size, int index, const std::uint64_t* weights) {
+    while (true) {
+        int left     = 2 * index + 1;
+        int right    = 2 * index + 2;
+        int smallest = index;
+
+        if (left < size && lighter(weights, heap[left], heap[smallest])) {
+            smallest = left;
+        }
+
+        if (right < size && lighter(weights, heap[right], heap[smallest])) {
+            smallest = right;
+        }
+
+        if (smallest == index) {
+            return;
+        }
+
+        std::swap(heap[smallest], heap[index]);
+        index = smallest;
+    }
+}
+
+}
+
+namespace hfm {
+
+CodeBuilder::CodeBuilder(int symbols)
+    : m_symbols(symbols), m_frequencies(symbols), m_weights(2 * symbols),
+      m_parents(2 * symbols), m_depths(2 * symbols), m_heap(symbols) {}
+
+unsigned int CodeBuilder::build(const std::uint64_t* frequencies, Code* codes,
+                                unsigned int maxLength) {
+    if (maxLength == 0 || maxLength > BITS) {
+        throw std::invalid_argument("Code length limit must be 1 to 64");
+    }
+
+    unsigned int longest = generateLengths(frequencies, codes);
+
+    // Codes over the limit come from very skewed distributions. Flatten the
+    // frequencies until they fit; all equal weights give a balanced tree.
+    if (longest > maxLength) {
+        std::copy(frequencies, frequencies + m_symbols, m_frequencies.begin());
+        while (longest > maxLength) {
+            for (auto& f : m_frequencies) {
+                if (f != 0) {
+                    f = (f >> 1) | 1;
+                }
+            }
+            longest = generateLengths(m_frequencies.data(), codes);
+        }
+    }
+
+    assignCanonicalCodes(codes, m_symbols);
+    return longest;
+}
+
+int CodeBuilder::getSymbols() const {
+    return m_symbols;
+}
+
+unsigned int CodeBuilder::generateLengths(const std::uint64_t* frequencies,
+                                          Code* codes) {
+    std::uint64_t* weights = m_weights.data();
+    int* heap              = m_heap.data();
+
+    int size = 0;
+    for (int i = 0; i < m_symbols; i++) {
+        codes[i].length = 0;
+        if (frequencies[i] != 0) {
+            weights[i]   = frequencies[i];
+            heap[size++] = i;
+        }
+    }
+
+    if (size == 0) {
+        return 0;
+    }
+
+    // A lone symbol still needs a one bit code, otherwise no data is written
+    if (size == 1) {
+        codes[heap[0]].length = 1;
+        return 1;
+    }
+
+    for (int i = size / 2 - 1; i >= 0; i--) {
+        siftDown(heap, size, i, weights);
+    }
+
+    // Merge the two lightest nodes until only the root is left
+    int next = m_symbols;
+    while (size > 1) {
+        int left = heap[0];
+        heap[0]  = heap[--size];
+        siftDown(heap, size, 0, weights);
+        int right = heap[0];
+
+        weights[next]    = weights[left] + weights[right];
+        m_parents[left]  = next;
+        m_parents[right] = next;
+        heap[0]          = next;
+        siftDown(heap, size, 0, weights);
+        next++;
+    }
+
+    // Parents are always numbered above their children, so walking down from
+    // the root gives every node its depth
+    int root       = next - 1;
+    m_depths[root] = 0;
+    for (int i = root - 1; i >= m_symbols; i--) {
+        m_depths[i] = m_depths[m_parents[i]] + 1;
+    }
+
+    unsigned int longest = 0;
+    for (int i = 0; i < m_symbols; i++) {
+        if (frequencies[i] != 0) {
+            codes[i].length = m_depths[m_parents[i]] + 1;
+            longest         = std::max(longest, codes[i].length);
+        }
+    }
+
+    return longest;
+}
+
+void CodeBuilder::assignCanonicalCodes(Code* codes, int symbols) {
+    // Codes of one length are consecutive numbers, in the order of the symbols
+    unsigned int lengthCounts[BITS + 1] = {};
+    for (int i = 0; i < symbols; i++) {
+        lengthCounts[codes[i].length]++;
+    }
+    lengthCounts[0] = 0;
+
+    std::uint64_t nextCode[BITS + 1] = {};
+    std::uint64_t code               = 0;
+    for (unsigned int bits = 1; bits <= BITS; bits++) {
+        code           = (code + lengthCounts[bits - 1]) << 1;
+        nextCode[bits] = code;
+    }
+
+    for (int i = 0; i < symbols; i++) {
+        codes[i].bits = codes[i].length == 0 ? 0 : nextCode[codes[i].length]++;
+    }
+}
+
+}
@@ -0,0 +1,47 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <ContextPool.hpp>
+#include <vector>
+
+namespace hfm {
+
+HuffmanCoder& ContextPool::getCoder(const char* inBuff,
+                                    std::uint64_t buffSize) {
+    thread_local HuffmanCoder coder(nullptr, 0);
+    coder.reset(inBuff, buffSize);
+    coder.setChecksum(false);
+
+    return coder;
+}
+
+HuffmanDecoder& ContextPool::getDecoder(const char* inBuff,
+                                        std::uint64_t buffSize) {
+    thread_local HuffmanDecoder decoder(nullptr, 0);
+    decoder.reset(inBuff, buffSize);
+    decoder.setChecksum(false);
+
+    return decoder;
+}
+
+char* ContextPool::getBuffer(std::uint64_t size) {
+    thread_local std::vector<char> buffer;
+    if (buffer.size() < size) {
+        buffer.resize(size);
+    }
+
+    return buffer.data();
+}
+
+}
@@ -0,0 +1,52 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <CpuFeatures.hpp>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    #include <intrin.h>
+    #include <immintrin.h>
+#endif
+
+namespace hfm {
+
+const CpuFeatures& CpuFeatures::get() {
+    static const CpuFeatures features;
+    return features;
+}
+
+CpuFeatures::CpuFeatures()
+    : sse42(false), bmi2(false) {
+#if (defined(__GNUC__) || defined(__clang__)) &&                               \
+    (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    sse42 = __builtin_cpu_supports("sse4.2") &&
+            __builtin_cpu_supports("popcnt");
+    bmi2  = __builtin_cpu_supports("bmi") && __builtin_cpu_supports("bmi2");
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int regs[4];
+    __cpuid(regs, 0);
+    const int maxLeaf = regs[0];
+
+    __cpuid(regs, 1);
+    sse42 = (regs[2] & (1 << 20)) != 0 && (regs[2] & (1 << 23)) != 0;
+
+    if (maxLeaf >= 7) {
+        __cpuidex(regs, 7, 0);
+        bmi2 = (regs[1] & (1 << 3)) != 0 && (regs[1] & (1 << 8)) != 0;
+    }
+#endif
+}
+
+}
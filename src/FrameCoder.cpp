@@ -0,0 +1,123 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <FrameCoder.hpp>
+#include <ByteOrder.hpp>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr int FREQ_SIZE = 256;
+constexpr int BYTES     = 8;
+constexpr int BITS      = 64;
+
+}
+
+namespace hfm {
+
+FrameCoder::FrameCoder() : m_builder(FREQ_SIZE), m_codes() {}
+
+std::uint64_t FrameCoder::compress(const char* inBuff, std::uint64_t size,
+                                   char* outBuff) {
+    if (size > MAX_SIZE) {
+        throw std::length_error("Message too large for a frame");
+    }
+
+    const Kernels& kernels  = Kernels::get();
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(inBuff);
+    std::uint64_t frequencies[FREQ_SIZE] = {};
+    kernels.histogram(in, size, frequencies);
+    m_builder.build(frequencies, m_codes, MAX_CODE_LENGTH);
+
+    // Exact size of both coded layouts, so the smallest mode is known
+    // before anything is written
+    int symbols        = 0;
+    std::uint64_t bits = 0;
+    for (int i = 0; i < FREQ_SIZE; i++) {
+        if (m_codes[i].length != 0) {
+            symbols++;
+            bits += frequencies[i] * m_codes[i].length;
+        }
+    }
+
+    const std::uint64_t lengths = (symbols + 1) / 2;
+    const std::uint64_t codes   = (bits + BYTES - 1) / BYTES;
+    const std::uint64_t list    = 1 + symbols + lengths + codes;
+    const std::uint64_t map     = MAP_SIZE + lengths + codes;
+
+    Mode mode = RAW;
+    if (symbols > 0 && list < size && list <= map) {
+        mode = LIST;
+    } else if (symbols > 0 && map < size) {
+        mode = MAP;
+    }
+
+    std::uint64_t written = writeVarint(outBuff, size << 2 | mode);
+    if (mode == RAW) {
+        std::copy(inBuff, inBuff + size, outBuff + written);
+        return written + size;
+    }
+
+    // Symbol table
+    if (mode == LIST) {
+        outBuff[written++] = static_cast<char>(symbols - 1);
+        for (int i = 0; i < FREQ_SIZE; i++) {
+            if (m_codes[i].length != 0) {
+                outBuff[written++] = static_cast<char>(i);
+            }
+        }
+    } else {
+        std::memset(outBuff + written, 0, MAP_SIZE);
+        for (int i = 0; i < FREQ_SIZE; i++) {
+            if (m_codes[i].length != 0) {
+                outBuff[written + i / 8] |= static_cast<char>(1 << (i % 8));
+            }
+        }
+        written += MAP_SIZE;
+    }
+
+    // Code lengths, two per byte
+    std::memset(outBuff + written, 0, lengths);
+    int index = 0;
+    for (int i = 0; i < FREQ_SIZE; i++) {
+        if (m_codes[i].length != 0) {
+            unsigned int shift = index % 2 == 0 ? 4 : 0;
+            outBuff[written + index / 2] |=
+                static_cast<char>(m_codes[i].length << shift);
+            index++;
+        }
+    }
+    written += lengths;
+
+    // Codes, with only the bytes holding bits of the last word written
+    std::uint64_t acc    = 0;
+    unsigned int accUsed = 0;
+    written += kernels.encode(in, size, m_codes, acc, accUsed,
+                              outBuff + written);
+    std::uint64_t word = accUsed == 0 ? 0 : acc << (BITS - accUsed);
+    for (unsigned int i = 0; i < (accUsed + BYTES - 1) / BYTES; i++) {
+        outBuff[written++] =
+            static_cast<char>((word >> ((BYTES - i - 1) * BYTES)) & 0xFF);
+    }
+
+    return written;
+}
+
+std::uint64_t FrameCoder::getMaxOutput(std::uint64_t size) {
+    return size + MAX_OVERHEAD;
+}
+
+}
@@ -0,0 +1,167 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <FrameDecoder.hpp>
+#include <ByteOrder.hpp>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr int FREQ_SIZE = 256;
+
+}
+
+namespace hfm {
+
+std::uint64_t FrameDecoder::getOriginalSize(const char* inBuff,
+                                            std::uint64_t buffSize) {
+    std::uint64_t header = 0;
+    std::uint64_t read   = readVarint(inBuff, buffSize, header);
+    if (read == 0) {
+        throw std::runtime_error("Truncated frame");
+    }
+
+    // Every byte takes at least one bit, so a damaged size is caught here
+    // before a buffer is allocated for it
+    const std::uint64_t size = header >> 2;
+    const std::uint64_t left = buffSize - read;
+    if ((header & 3) == FrameCoder::RAW ? size > left : size / 8 > left) {
+        throw std::runtime_error("Truncated frame");
+    }
+
+    return size;
+}
+
+std::uint64_t FrameDecoder::decompress(const char* inBuff,
+                                       std::uint64_t buffSize,
+                                       char* outBuff) {
+    std::uint64_t header = 0;
+    std::uint64_t read   = readVarint(inBuff, buffSize, header);
+    if (read == 0) {
+        throw std::runtime_error("Truncated frame");
+    }
+
+    const std::uint64_t size = header >> 2;
+    const unsigned int mode  = header & 3;
+    if (mode == FrameCoder::RAW) {
+        if (buffSize - read < size) {
+            throw std::runtime_error("Truncated frame");
+        }
+
+        std::copy(inBuff + read, inBuff + read + size, outBuff);
+        return read + size;
+    }
+
+    // Symbols of the table, in ascending order
+    unsigned char symbols[SYMBOLS];
+    int count = 0;
+    if (mode == FrameCoder::LIST) {
+        if (buffSize - read < 1) {
+            throw std::runtime_error("Truncated frame");
+        }
+
+        count = static_cast<unsigned char>(inBuff[read++]) + 1;
+        if (buffSize - read < static_cast<std::uint64_t>(count)) {
+            throw std::runtime_error("Truncated frame");
+        }
+
+        for (int i = 0; i < count; i++) {
+            symbols[i] = static_cast<unsigned char>(inBuff[read + i]);
+            if (i > 0 && symbols[i] <= symbols[i - 1]) {
+                throw std::runtime_error("Invalid frame table");
+            }
+        }
+        read += count;
+    } else if (mode == FrameCoder::MAP) {
+        if (buffSize - read < FrameCoder::MAP_SIZE) {
+            throw std::runtime_error("Truncated frame");
+        }
+
+        for (int i = 0; i < FREQ_SIZE; i++) {
+            if ((inBuff[read + i / 8] >> (i % 8)) & 1) {
+                symbols[count++] = static_cast<unsigned char>(i);
+            }
+        }
+        read += FrameCoder::MAP_SIZE;
+    } else {
+        throw std::runtime_error("Unknown frame mode");
+    }
+
+    // Code lengths, sorted into canonical order (by length, then symbol)
+    const std::uint64_t lengthBytes = (count + 1) / 2;
+    if (count == 0 || buffSize - read < lengthBytes) {
+        throw std::runtime_error("Truncated frame");
+    }
+
+    unsigned char lengths[SYMBOLS];
+    std::memset(m_lengthCounts, 0, sizeof(m_lengthCounts));
+    for (int i = 0; i < count; i++) {
+        unsigned char packed = static_cast<unsigned char>(inBuff[read + i / 2]);
+        lengths[i]           = i % 2 == 0 ? packed >> 4 : packed & 0xF;
+        if (lengths[i] == 0) {
+            throw std::runtime_error("Invalid frame table");
+        }
+        m_lengthCounts[lengths[i]]++;
+    }
+    read += lengthBytes;
+
+    unsigned int offsets[FrameCoder::MAX_CODE_LENGTH + 1] = {};
+    for (unsigned int i = 1; i < FrameCoder::MAX_CODE_LENGTH; i++) {
+        offsets[i + 1] = offsets[i] + m_lengthCounts[i];
+    }
+    for (int i = 0; i < count; i++) {
+        m_sorted[offsets[lengths[i]]++] = symbols[i];
+    }
+
+    // Codes, read most significant bit first. At every length the codes of
+    // that length are the values first to first + count - 1.
+    const unsigned char* in =
+        reinterpret_cast<const unsigned char*>(inBuff + read);
+    const std::uint64_t available = (buffSize - read) * 8;
+    std::uint64_t bitPos          = 0;
+    for (std::uint64_t i = 0; i < size; i++) {
+        unsigned int code   = 0;
+        unsigned int first  = 0;
+        unsigned int index  = 0;
+        unsigned int length = 1;
+        for (; length <= FrameCoder::MAX_CODE_LENGTH; length++) {
+            if (bitPos == available) {
+                throw std::runtime_error("Truncated frame");
+            }
+
+            code |= (in[bitPos / 8] >> (7 - bitPos % 8)) & 1;
+            bitPos++;
+
+            unsigned int codes = m_lengthCounts[length];
+            if (code - first < codes) {
+                outBuff[i] = static_cast<char>(m_sorted[index + code - first]);
+                break;
+            }
+
+            index += codes;
+            first = (first + codes) << 1;
+            code <<= 1;
+        }
+
+        if (length > FrameCoder::MAX_CODE_LENGTH) {
+            throw std::runtime_error("Invalid code in frame");
+        }
+    }
+
+    return read + (bitPos + 7) / 8;
+}
+
+}
@@ -0,0 +1,130 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <Histogram.hpp>
+#include <CodeBuilder.hpp>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+
+namespace {
+
+constexpr char MAGIC[3]        = {'H', 'F', 'Q'};
+constexpr std::uint8_t VERSION = 1;
+// Largest total the counts may add up to, when serialized and when merged,
+// so no count or total can overflow
+constexpr std::uint64_t MAX_TOTAL = std::uint64_t(1) << 56;
+
+}
+
+namespace hfm {
+
+Histogram::Histogram() : m_counts() {}
+
+Histogram::Histogram(const std::uint64_t* counts) {
+    std::copy(counts, counts + SYMBOLS, m_counts);
+}
+
+void Histogram::add(const char* data, std::uint64_t size) {
+    Kernels::get().histogram(reinterpret_cast<const unsigned char*>(data),
+                             size, m_counts);
+}
+
+void Histogram::merge(const Histogram& other) {
+    const std::uint64_t total = getTotal();
+    if (total > MAX_TOTAL || other.getTotal() > MAX_TOTAL - total) {
+        throw std::runtime_error("Invalid histogram");
+    }
+
+    for (int i = 0; i < SYMBOLS; i++) {
+        m_counts[i] += other.m_counts[i];
+    }
+}
+
+const std::uint64_t* Histogram::getCounts() const {
+    return m_counts;
+}
+
+std::uint64_t Histogram::getTotal() const {
+    std::uint64_t total = 0;
+    for (std::uint64_t count : m_counts) {
+        total += count;
+    }
+
+    return total;
+}
+
+bool Histogram::covers(const Histogram& other) const {
+    for (int i = 0; i < SYMBOLS; i++) {
+        if (other.m_counts[i] != 0 && m_counts[i] == 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void Histogram::buildCodes(Code* codes) const {
+    CodeBuilder builder(SYMBOLS);
+    builder.build(m_counts, codes, MAX_CODE_LENGTH);
+}
+
+HuffmanCoder::Dictionary Histogram::buildDictionary() const {
+    Code codes[SYMBOLS];
+    buildCodes(codes);
+
+    return HuffmanCoder::makeDictionary(codes);
+}
+
+std::uint64_t Histogram::serialize(char* out) const {
+    std::memcpy(out, MAGIC, sizeof(MAGIC));
+    out[3] = static_cast<char>(VERSION);
+
+    std::uint64_t written = 4;
+    for (std::uint64_t count : m_counts) {
+        written += writeVarint(out + written, count);
+    }
+
+    return written;
+}
+
+Histogram Histogram::deserialize(const char* in, std::uint64_t size) {
+    if (size < 4 || std::memcmp(in, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error("Not a histogram");
+    }
+    if (static_cast<std::uint8_t>(in[3]) != VERSION) {
+        throw std::runtime_error("Unsupported histogram version");
+    }
+
+    Histogram histogram;
+    std::uint64_t read  = 4;
+    std::uint64_t total = 0;
+    for (std::uint64_t& count : histogram.m_counts) {
+        unsigned int used = readVarint(in + read, size - read, count);
+        if (used == 0 || count > MAX_TOTAL - total) {
+            throw std::runtime_error("Invalid histogram");
+        }
+
+        read += used;
+        total += count;
+    }
+
+    if (read != size) {
+        throw std::runtime_error("Invalid histogram");
+    }
+
+    return histogram;
+}
+
+}
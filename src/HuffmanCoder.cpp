@@ -13,66 +13,197 @@
 // limitations under the License.
 
 #include <HuffmanCoder.hpp>
+#include <ByteOrder.hpp>
 #include <stdexcept>
+#include <algorithm>
+#include <iterator>
 
 namespace {
 
 constexpr int FREQ_SIZE = 256;
 constexpr int BYTES     = 8;
 constexpr int BITS      = 64;
+// Input is checksummed and coded in pieces small enough to stay in the L1
+// cache between the two, so it is only read once from memory
+constexpr std::uint64_t CHECKSUM_CHUNK = 16 << 10;
 
 }
 
 namespace hfm {
 
-HuffmanCoder::HuffmanCoder(char* inBuff, unsigned long buffSize)
-    : m_inBuff(inBuff), m_inEnd(inBuff + buffSize), m_buffSize(buffSize),
-      m_headerWritten(false), m_acc(0), m_accUsed(0) {}
+HuffmanCoder::HuffmanCoder(const char* inBuff, std::uint64_t buffSize)
+    : m_dictionaryReady(false), m_codesLoaded(false),
+      m_writeDictionary(true), m_inBuff(inBuff),
+      m_inEnd(inBuff + buffSize), m_buffSize(buffSize), m_headerWritten(false),
+      m_codes(), m_maxCodeLength(0), m_codesReady(false),
+      m_frequenciesReady(false), m_builder(FREQ_SIZE),
+      m_acc(0), m_accUsed(0), m_lastBytes(0), m_checksum(false), m_crc(0) {}
 
 HuffmanCoder::HuffmanCoder(HuffmanCoder&& other) noexcept
-    : m_dictionary(std::move(other.m_dictionary)), m_inBuff(other.m_inBuff),
+    : m_dictionary(std::move(other.m_dictionary)),
+      m_dictionaryReady(other.m_dictionaryReady),
+      m_codesLoaded(other.m_codesLoaded),
+      m_writeDictionary(other.m_writeDictionary), m_inBuff(other.m_inBuff),
       m_inEnd(other.m_inEnd), m_buffSize(other.m_buffSize),
-      m_headerWritten(other.m_headerWritten), m_acc(other.m_acc),
-      m_accUsed(other.m_accUsed) {
-    other.m_inBuff        = nullptr;
-    other.m_inEnd         = nullptr;
-    other.m_buffSize      = 0;
-    other.m_headerWritten = false;
-    other.m_acc           = 0;
-    other.m_accUsed       = 0;
+      m_headerWritten(other.m_headerWritten),
+      m_maxCodeLength(other.m_maxCodeLength),
+      m_codesReady(other.m_codesReady),
+      m_frequenciesReady(other.m_frequenciesReady),
+      m_builder(std::move(other.m_builder)),
+      m_acc(other.m_acc), m_accUsed(other.m_accUsed),
+      m_lastBytes(other.m_lastBytes), m_checksum(other.m_checksum),
+      m_crc(other.m_crc) {
+    std::copy(std::begin(other.m_codes), std::end(other.m_codes), m_codes);
+    std::copy(std::begin(other.m_frequencies), std::end(other.m_frequencies),
+              m_frequencies);
+    other.m_dictionaryReady  = false;
+    other.m_codesLoaded      = false;
+    other.m_inBuff           = nullptr;
+    other.m_inEnd            = nullptr;
+    other.m_buffSize         = 0;
+    other.m_headerWritten    = false;
+    other.m_codesReady       = false;
+    other.m_frequenciesReady = false;
+    other.m_acc              = 0;
+    other.m_accUsed          = 0;
+    other.m_lastBytes        = 0;
+    other.m_checksum         = false;
+    other.m_crc              = 0;
+}
+
+void HuffmanCoder::reset(const char* inBuff, std::uint64_t buffSize) {
+    m_inBuff           = inBuff;
+    m_inEnd            = inBuff + buffSize;
+    m_buffSize         = buffSize;
+    m_headerWritten    = false;
+    m_acc              = 0;
+    m_accUsed          = 0;
+    m_lastBytes        = 0;
+    m_crc              = 0;
+    m_frequenciesReady = false;
+
+    // A dictionary given through loadDictionary() is kept for the new input
+    if (!m_codesLoaded) {
+        m_codesReady      = false;
+        m_dictionaryReady = false;
+    }
 }
 
 HuffmanCoder::Dictionary& HuffmanCoder::getDictionary() {
+    if (!m_codesReady) {
+        generateCodes();
+    }
+
+    if (!m_dictionaryReady) {
+        m_dictionary      = makeDictionary(m_codes);
+        m_dictionaryReady = true;
+    }
+
     return m_dictionary;
 }
 
 void HuffmanCoder::loadDictionary(const Dictionary& dictionary) {
-    m_dictionary = dictionary;
-}
+    Code codes[FREQ_SIZE] = {};
+    unsigned int maxCodeLength = 0;
+
+    for (const auto& c : dictionary) {
+        if (c.second.empty() || c.second.size() > BITS) {
+            throw std::invalid_argument("Codes must be 1 to 64 bits long");
+        }
 
-long HuffmanCoder::compress(char* outBuff, unsigned long numBytes) {
-    if (m_dictionary.empty()) {
-        generateDictionary();
-        if (m_dictionary.empty()) {
-            throw std::runtime_error("Unable to create dictionary");
+        Code& code = codes[c.first];
+        for (const auto& bit : c.second) {
+            code.bits = (code.bits << 1) | (bit == '1' ? 1 : 0);
         }
+        code.length   = c.second.size();
+        maxCodeLength = std::max(maxCodeLength, code.length);
+    }
+
+    std::copy(std::begin(codes), std::end(codes), m_codes);
+    m_maxCodeLength   = maxCodeLength;
+    m_dictionary      = dictionary;
+    m_dictionaryReady = true;
+    m_codesLoaded     = true;
+    m_codesReady      = true;
+}
+
+void HuffmanCoder::setWriteDictionary(bool enabled) {
+    m_writeDictionary = enabled;
+}
+
+void HuffmanCoder::setChecksum(bool enabled) {
+    m_checksum = enabled;
+}
+
+std::uint32_t HuffmanCoder::getChecksum() const {
+    return m_crc;
+}
+
+std::uint64_t HuffmanCoder::getLastBytes() const {
+    return m_lastBytes;
+}
+
+const std::uint64_t* HuffmanCoder::getFrequencies() {
+    if (!m_frequenciesReady) {
+        fillFrequencies(m_frequencies);
+    }
+
+    return m_frequencies;
+}
+
+std::uint64_t HuffmanCoder::getCompressedSize() {
+    if (!m_codesReady) {
+        generateCodes();
+    }
+
+    const std::uint64_t* frequencies = getFrequencies();
+    std::uint64_t bits = 0;
+    for (int i = 0; i < FREQ_SIZE; i++) {
+        bits += frequencies[i] * m_codes[i].length;
+    }
+
+    return getHeaderSize() + (bits + BYTES - 1) / BYTES;
+}
+
+std::int64_t HuffmanCoder::compress(char* outBuff, std::uint64_t numBytes) {
+    if (!m_codesReady) {
+        generateCodes();
+    }
+
+    if (m_maxCodeLength == 0 && m_buffSize != 0) {
+        throw std::runtime_error("Unable to create dictionary");
     }
 
     // if we reached the end of the input
     if (m_inBuff == m_inEnd) {
+        // Empty input, the stream is just the header
+        if (!m_headerWritten) {
+            if (numBytes < getHeaderSize()) {
+                throw std::length_error("Output buffer too small");
+            }
+
+            m_headerWritten = true;
+            return writeStreamHeader(outBuff);
+        }
+
         // If there are bits that were not written to the buffer
         // then flush them
         if (m_accUsed > 0) {
-            // Pad them with 0 at the end
-            for (int i = 0; i < BITS - m_accUsed; i++) {
-                m_acc <<= 1;
+            // Only the bytes holding bits, the decoder pads the rest
+            const std::uint64_t lastBytes = (m_accUsed + BYTES - 1) / BYTES;
+            if (numBytes < lastBytes) {
+                throw std::length_error("Output buffer too small");
             }
 
-            // Write them to the buffer
-            for (int i = 0; i < BYTES; i++) {
-                outBuff[i] = (m_acc >> ((BYTES - i - 1) * BYTES)) & 0xFF;
+            // Pad them with 0 at the end and write them to the buffer
+            std::uint64_t word = m_acc << (BITS - m_accUsed);
+            for (std::uint64_t i = 0; i < lastBytes; i++) {
+                outBuff[i] = (word >> ((BYTES - i - 1) * BYTES)) & 0xFF;
             }
 
+            m_acc       = 0;
+            m_accUsed   = 0;
+            m_lastBytes = lastBytes;
             return -2; // Signal flush needed
         }
 
@@ -80,178 +211,186 @@ long HuffmanCoder::compress(char* outBuff, unsigned long numBytes) {
     }
 
     // Write header if it was not written before
-    unsigned int prefixSize = 0; // Size of prefixed bytes
+    std::uint64_t bytesWrote = 0; // Number of bytes written to the buffer
     if (!m_headerWritten) {
-        prefixSize      = writeStreamHeader(outBuff);
-        m_headerWritten = true;
-    }
-
-    unsigned int bytesWrote =
-        prefixSize;   // Number of bytes written to the buffer
-    int bitsLeft = 0; // Number of bits left to process in current code
+        // Bytes without a code would be left out of the stream
+        if (m_codesLoaded) {
+            const std::uint64_t* frequencies = getFrequencies();
+            for (int i = 0; i < FREQ_SIZE; i++) {
+                if (frequencies[i] != 0 && m_codes[i].length == 0) {
+                    throw std::runtime_error("Input has bytes without codes");
+                }
+            }
+        }
 
-    // Do this for every byte of the data
-    for (unsigned long i = 0; i < numBytes; i++) {
-        // Check if reached end of input
-        if (&m_inBuff[i] == m_inEnd) {
-            m_inBuff = m_inEnd;
-            break;
+        // The header is written whole, with the dictionary up to
+        // MAX_HEADER_SIZE bytes
+        if (numBytes < getHeaderSize()) {
+            throw std::length_error("Output buffer too small");
         }
 
-        // Get corresponding code for current byte
-        std::string code = m_dictionary[m_inBuff[i]];
-        bitsLeft         = code.size(); // Get the size of the code
-
-        // Do this untill the full code has been processed
-        while (bitsLeft > 0) {
-            // if accumulator is full
-            if (m_accUsed == BITS) {
-                // Write 64 bit integer to byte array
-                for (int i = 0; i < BYTES; i++) {
-                    outBuff[bytesWrote + i] =
-                        (m_acc >> ((BYTES - i - 1) * BYTES)) & 0xFF;
-                }
-                // Reset counters
-                m_accUsed = 0;
-                m_acc     = 0;
-                bytesWrote += BYTES;
-            } else {
-                // If current bit is 0 then add a 0 the the acuumulator (shift
-                // left) otherwise shift left and add a 1
-                if (code[code.size() - bitsLeft] == '0') {
-                    m_acc <<= 1;
-                } else {
-                    m_acc <<= 1;
-                    m_acc |= 1;
-                }
+        bytesWrote      = writeStreamHeader(outBuff);
+        m_headerWritten = true;
+    }
 
-                bitsLeft--;
-                m_accUsed++;
-            }
-        }
+    // Every symbol adds at most m_maxCodeLength bits and at most one word is
+    // pending in the accumulator, so only take as much input as will fit
+    std::uint64_t room = numBytes > bytesWrote + BYTES
+                             ? numBytes - bytesWrote - BYTES
+                             : 0;
+    std::uint64_t symbols = m_inEnd - m_inBuff;
+    std::uint64_t fit     = room * BYTES / m_maxCodeLength;
+    if (fit < symbols) {
+        symbols = fit;
     }
 
-    // Update input buffer if end was not reached
-    if (m_inBuff != m_inEnd) {
-        m_inBuff += numBytes;
+    if (symbols == 0 && bytesWrote == 0) {
+        throw std::length_error("Output buffer too small");
+    }
+
+    const Kernels& kernels = Kernels::get();
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(m_inBuff);
+    if (m_checksum) {
+        for (std::uint64_t i = 0; i < symbols; i += CHECKSUM_CHUNK) {
+            std::uint64_t n = std::min(symbols - i, CHECKSUM_CHUNK);
+            m_crc = kernels.crc32c(m_crc, in + i, n);
+            bytesWrote += kernels.encode(in + i, n, m_codes, m_acc, m_accUsed,
+                                         outBuff + bytesWrote);
+        }
+    } else {
+        bytesWrote += kernels.encode(in, symbols, m_codes, m_acc, m_accUsed,
+                                     outBuff + bytesWrote);
     }
+    m_inBuff += symbols;
 
     return bytesWrote;
 }
 
 HuffmanCoder& HuffmanCoder::operator=(HuffmanCoder&& other) noexcept {
     // Move fields
-    m_dictionary    = std::move(other.m_dictionary);
-    m_inBuff        = other.m_inBuff;
-    m_inEnd         = other.m_inEnd;
-    m_buffSize      = other.m_buffSize;
-    m_headerWritten = other.m_headerWritten;
-    m_acc           = other.m_acc;
-    m_accUsed       = other.m_accUsed;
+    m_dictionary       = std::move(other.m_dictionary);
+    m_dictionaryReady  = other.m_dictionaryReady;
+    m_codesLoaded      = other.m_codesLoaded;
+    m_writeDictionary  = other.m_writeDictionary;
+    m_inBuff           = other.m_inBuff;
+    m_inEnd            = other.m_inEnd;
+    m_buffSize         = other.m_buffSize;
+    m_headerWritten    = other.m_headerWritten;
+    m_maxCodeLength    = other.m_maxCodeLength;
+    m_codesReady       = other.m_codesReady;
+    m_frequenciesReady = other.m_frequenciesReady;
+    m_builder          = std::move(other.m_builder);
+    m_acc              = other.m_acc;
+    m_accUsed          = other.m_accUsed;
+    m_lastBytes        = other.m_lastBytes;
+    m_checksum         = other.m_checksum;
+    m_crc              = other.m_crc;
+    std::copy(std::begin(other.m_codes), std::end(other.m_codes), m_codes);
+    std::copy(std::begin(other.m_frequencies), std::end(other.m_frequencies),
+              m_frequencies);
 
     // Invalidate fields of other
-    other.m_inBuff        = nullptr;
-    other.m_inEnd         = nullptr;
-    other.m_buffSize      = 0;
-    other.m_headerWritten = false;
-    other.m_acc           = 0;
-    other.m_accUsed       = 0;
+    other.m_dictionaryReady  = false;
+    other.m_codesLoaded      = false;
+    other.m_inBuff           = nullptr;
+    other.m_inEnd            = nullptr;
+    other.m_buffSize         = 0;
+    other.m_headerWritten    = false;
+    other.m_codesReady       = false;
+    other.m_frequenciesReady = false;
+    other.m_acc              = 0;
+    other.m_accUsed          = 0;
+    other.m_lastBytes        = 0;
+    other.m_checksum         = false;
+    other.m_crc              = 0;
 
     return *this;
 }
 
-void HuffmanCoder::generateDictionary() {
-    int frequencies[FREQ_SIZE];
-
-    fillFrequencies(frequencies);
-    generateTree(frequencies);
-    fillDictionary(m_tree.getMin());
-}
-
-void HuffmanCoder::fillFrequencies(int* frequencies) {
+HuffmanCoder::Dictionary HuffmanCoder::makeDictionary(const Code* codes) {
+    Dictionary dictionary;
     for (int i = 0; i < FREQ_SIZE; i++) {
-        frequencies[i] = 0;
-    }
-
-    for (unsigned long i = 0; i < m_buffSize; i++) {
-        frequencies[reinterpret_cast<unsigned char*>(m_inBuff)[i]]++;
-    }
-}
+        const Code& code = codes[i];
+        if (code.length == 0) {
+            continue;
+        }
 
-void HuffmanCoder::generateTree(const int* frequencies) {
-    for (int i = 0; i < FREQ_SIZE; i++) {
-        if (frequencies[i] != 0) {
-            HuffmanNode* n = new HuffmanNode;
-            n->left        = nullptr;
-            n->right       = nullptr;
-            n->frequency   = frequencies[i];
-            n->symbol      = static_cast<unsigned char>(i);
-
-            m_tree.insert(n);
+        std::string bits;
+        for (unsigned int j = code.length; j > 0; j--) {
+            bits += ((code.bits >> (j - 1)) & 1) ? '1' : '0';
         }
+        dictionary[static_cast<unsigned char>(i)] = bits;
     }
 
-    while (m_tree.getSize() != 1) {
-        HuffmanNode* left  = m_tree.popMin();
-        HuffmanNode* right = m_tree.popMin();
-        HuffmanNode* top   = new HuffmanNode;
+    return dictionary;
+}
 
-        top->frequency = left->frequency + right->frequency;
-        top->symbol    = HuffmanNode::NO_SYMBOL;
-        top->left      = left;
-        top->right     = right;
+void HuffmanCoder::generateCodes() {
+    getFrequencies();
 
-        m_tree.insert(top);
-    }
+    // Codes must fit the 64 bit accumulator
+    m_maxCodeLength   = m_builder.build(m_frequencies, m_codes, BITS);
+    m_dictionaryReady = false;
+    m_codesReady      = true;
 }
 
-void HuffmanCoder::fillDictionary(const HuffmanNode* root, std::string code) {
-    if (root->left != nullptr) {
-        code += '0';
-        fillDictionary(root->left, code);
-        code.pop_back();
+void HuffmanCoder::fillFrequencies(std::uint64_t* frequencies) {
+    for (int i = 0; i < FREQ_SIZE; i++) {
+        frequencies[i] = 0;
     }
 
-    if (root->right != nullptr) {
-        code += '1';
-        fillDictionary(root->right, code);
-        code.pop_back();
-    }
+    // m_inBuff moves while coding, the input always starts here
+    const char* start = m_inEnd - m_buffSize;
+    Kernels::get().histogram(reinterpret_cast<const unsigned char*>(start),
+                             m_buffSize, frequencies);
+    m_frequenciesReady = true;
+}
 
-    if (root->right == nullptr && root->left == nullptr) {
-        m_dictionary[root->symbol] = code;
+std::uint64_t HuffmanCoder::getHeaderSize() const {
+    std::uint64_t size = sizeof(std::uint64_t) + sizeof(std::uint16_t);
+    for (const auto& code : m_codes) {
+        if (code.length != 0 && m_writeDictionary) {
+            size += 2 + (code.length + BYTES - 1) / BYTES;
+        }
     }
+
+    return size;
 }
 
-unsigned int HuffmanCoder::writeStreamHeader(char* outBuff) {
-    unsigned int written = 0;
+std::uint64_t HuffmanCoder::writeStreamHeader(char* outBuff) {
+    std::uint64_t written = 0;
     // Write original data size
-    reinterpret_cast<unsigned long*>(outBuff)[0] = m_buffSize;
-    written += sizeof(m_buffSize);
-    outBuff += written;
-    // Write dictionary size
-    reinterpret_cast<std::uint8_t*>(outBuff)[0] = m_dictionary.size();
-    written += sizeof(std::uint8_t);
-    outBuff += sizeof(std::uint8_t);
+    writeLE64(outBuff, m_buffSize);
+    written += sizeof(std::uint64_t);
+    // Write dictionary size, 0 if the decoder has the codes already
+    std::uint16_t dictSize = 0;
+    for (const auto& code : m_codes) {
+        dictSize += code.length != 0 && m_writeDictionary ? 1 : 0;
+    }
+    writeLE16(outBuff + written, dictSize);
+    written += sizeof(std::uint16_t);
+    if (dictSize == 0) {
+        return written;
+    }
     // Write dictionary
-    for (const auto& c : m_dictionary) {
-        // Write code size
-        reinterpret_cast<std::uint8_t*>(outBuff)[0] = c.second.size();
-        written += sizeof(std::uint8_t);
-        outBuff += sizeof(std::uint8_t);
-        // Write code
-        for (const auto& chr : c.second) {
-            outBuff[0] = chr;
-            written++;
-            outBuff++;
+    for (int i = 0; i < FREQ_SIZE; i++) {
+        const Code& code = m_codes[i];
+        if (code.length == 0) {
+            continue;
+        }
+
+        // Write byte, code size and the code bits packed from the MSB
+        outBuff[written++] = static_cast<char>(i);
+        outBuff[written++] = static_cast<char>(code.length);
+        unsigned int codeBytes = (code.length + BYTES - 1) / BYTES;
+        std::uint64_t aligned =
+            code.length == 0 ? 0 : code.bits << (BITS - code.length);
+        for (unsigned int i = 0; i < codeBytes; i++) {
+            outBuff[written++] = (aligned >> ((BYTES - i - 1) * BYTES)) & 0xFF;
         }
-        // Write byte for code
-        reinterpret_cast<unsigned char*>(outBuff)[0] = c.first;
-        written++;
-        outBuff++;
     }
 
     return written;
 }
 
-}
\ No newline at end of file
+}
@@ -13,60 +13,123 @@
 // limitations under the License.
 
 #include <HuffmanDecoder.hpp>
+#include <ByteOrder.hpp>
+#include <stdexcept>
+#include <algorithm>
+#include <iterator>
+#include <cstring>
 
 namespace {
 
-constexpr int BYTES = 8;
-constexpr int BITS  = 64;
+constexpr int FREQ_SIZE = 256;
+constexpr int BYTES     = 8;
+constexpr int BITS      = 64;
+constexpr unsigned int TABLE_BITS  = hfm::HuffmanDecoder::TABLE_BITS;
+constexpr unsigned int MAX_SYMBOLS = hfm::HuffmanDecoder::MAX_SYMBOLS;
+// Output is checksummed in pieces small enough to still be in the L1 cache
+constexpr std::uint64_t CHECKSUM_CHUNK = 16 << 10;
 
 }
 
 namespace hfm {
 
-HuffmanDecoder::HuffmanDecoder(const char* inBuff, unsigned long buffSize)
-    : m_inBuff(inBuff), m_inBuffSize(buffSize), m_dictLoaded(false),
-      m_originalSize(0), m_processed(0), m_acc(0), m_accUsed(0),
-      m_tree(nullptr), m_read(0), m_lastBytes(0) {}
+HuffmanDecoder::HuffmanDecoder(const char* inBuff, std::uint64_t buffSize)
+    : m_dictReady(false), m_inBuff(inBuff), m_inBuffSize(buffSize),
+      m_dictLoaded(false), m_headerRead(false), m_originalSize(0), m_codes(),
+      m_treeSize(0), m_maxCodeLength(0), m_table(), m_processed(0),
+      m_bitPos(0), m_lastBytes(0), m_checksum(false), m_crc(0) {}
 
 HuffmanDecoder::HuffmanDecoder(HuffmanDecoder&& other) noexcept
-    : m_dict(std::move(other.m_dict)), m_inBuff(other.m_inBuff),
-      m_inBuffSize(other.m_inBuffSize), m_dictLoaded(other.m_dictLoaded),
-      m_originalSize(other.m_originalSize), m_processed(other.m_processed),
-      m_acc(other.m_acc), m_accUsed(other.m_accUsed), m_tree(other.m_tree),
-      m_read(other.m_read), m_lastBytes(other.m_lastBytes) {
+    : m_dict(std::move(other.m_dict)), m_dictReady(other.m_dictReady),
+      m_inBuff(other.m_inBuff), m_inBuffSize(other.m_inBuffSize),
+      m_dictLoaded(other.m_dictLoaded), m_headerRead(other.m_headerRead),
+      m_originalSize(other.m_originalSize), m_treeSize(other.m_treeSize),
+      m_maxCodeLength(other.m_maxCodeLength),
+      m_processed(other.m_processed), m_bitPos(other.m_bitPos),
+      m_lastBytes(other.m_lastBytes), m_checksum(other.m_checksum),
+      m_crc(other.m_crc) {
+    std::copy(std::begin(other.m_codes), std::end(other.m_codes), m_codes);
+    std::copy(&other.m_tree[0][0], &other.m_tree[0][0] + m_treeSize * 2,
+              &m_tree[0][0]);
+    std::copy(std::begin(other.m_table), std::end(other.m_table), m_table);
+    other.m_dictReady    = false;
     other.m_inBuff       = nullptr;
     other.m_inBuffSize   = 0;
     other.m_dictLoaded   = false;
+    other.m_headerRead   = false;
     other.m_originalSize = 0;
+    other.m_treeSize     = 0;
     other.m_processed    = 0;
-    other.m_acc          = 0;
-    other.m_accUsed      = 0;
-    other.m_tree         = nullptr;
-    other.m_read         = 0;
+    other.m_bitPos       = 0;
     other.m_lastBytes    = 0;
+    other.m_checksum     = false;
+    other.m_crc          = 0;
+}
+
+void HuffmanDecoder::reset(const char* inBuff, std::uint64_t buffSize) {
+    m_inBuff       = inBuff;
+    m_inBuffSize   = buffSize;
+    m_headerRead   = false;
+    m_originalSize = 0;
+    m_processed    = 0;
+    m_bitPos       = 0;
+    m_lastBytes    = 0;
+    m_crc          = 0;
+
+    // A dictionary given through loadDictionary() is kept for the new input
+    if (!m_dictLoaded) {
+        m_treeSize  = 0;
+        m_dictReady = false;
+    }
 }
 
 void HuffmanDecoder::loadDictionary(const Dictionary& dict) {
+    Code codes[FREQ_SIZE] = {};
+
     for (const auto& it : dict) {
-        m_dict[it.second] = it.first;
+        if (it.second.empty() || it.second.size() > BITS) {
+            throw std::invalid_argument("Codes must be 1 to 64 bits long");
+        }
+
+        Code& code = codes[it.first];
+        for (const auto& bit : it.second) {
+            code.bits = (code.bits << 1) | (bit == '1' ? 1 : 0);
+        }
+        code.length = it.second.size();
     }
+
+    std::copy(std::begin(codes), std::end(codes), m_codes);
+    m_dictLoaded = true;
+    m_dictReady  = false;
+    generateTreeFromCodes();
 }
 
 HuffmanDecoder::ReverseDictionary& HuffmanDecoder::getDecodingDictionary() {
+    if (!m_dictReady) {
+        m_dict.clear();
+        for (int i = 0; i < FREQ_SIZE; i++) {
+            const Code& code = m_codes[i];
+            if (code.length == 0) {
+                continue;
+            }
+
+            std::string bits;
+            for (unsigned int j = code.length; j > 0; j--) {
+                bits += ((code.bits >> (j - 1)) & 1) ? '1' : '0';
+            }
+            m_dict[bits] = static_cast<unsigned char>(i);
+        }
+        m_dictReady = true;
+    }
+
     return m_dict;
 }
 
-long HuffmanDecoder::decompress(char* outBuff, unsigned long numBytes) {
-    if (m_dict.empty()) {
+std::int64_t HuffmanDecoder::decompress(char* outBuff, std::uint64_t numBytes) {
+    if (!m_headerRead) {
         loadDictionaryFromStream();
-        // Read a 64 bit integer from the input byte array
-        for (int i = 0; i < BYTES; i++) {
-            std::uint8_t byte     = m_inBuff[i];
-            std::uint8_t shiftNo  = (BYTES - i - 1) * BYTES;
-            std::uint64_t shifted = static_cast<std::uint64_t>(byte) << shiftNo;
-            m_acc |= shifted;
-        }
-        m_read = BYTES;
+        m_headerRead = true;
+        m_bitPos     = 0;
     }
 
     // if we reached the end of the input
@@ -75,69 +138,35 @@ long HuffmanDecoder::decompress(char* outBuff, unsigned long numBytes) {
     }
 
     // Generate a huffman tree from the current dictionary
-    if (m_tree == nullptr) {
-        m_tree = generateTreeFromDictionary();
+    if (m_treeSize == 0) {
+        generateTreeFromCodes();
     }
-    HuffmanNode* r = m_tree;
-
-    unsigned int bytesWrote = 0; // Number of bytes written to the buffer
-    m_lastBytes             = 0;
-
-    // The next part gets every bit from the input buffer
-    // and traverses the generated huffman tree
-    for (unsigned long i = 0; i < numBytes; i++) {
-        // if we reached the end of the input
-        if (m_processed >= m_originalSize) {
-            return -2; // Signal end of buffer and flush needed
+    Kernels::RefillFn refill = Kernels::get().refill;
+    Kernels::Crc32cFn crc32c = Kernels::get().crc32c;
+    const unsigned char* out = reinterpret_cast<unsigned char*>(outBuff);
+
+    std::uint64_t bytesWrote = 0; // Number of bytes written to the buffer
+    std::uint64_t wanted = std::min(numBytes, m_originalSize - m_processed);
+
+    while (bytesWrote < wanted) {
+        // With a checksum the output is decoded in pieces that are added to
+        // it while they are still in the L1 cache
+        std::uint64_t count = wanted - bytesWrote;
+        if (m_checksum) {
+            count = std::min(count, CHECKSUM_CHUNK);
         }
 
-        std::string code = "";
-        // Process untill we have a full code
-        while (true) {
-            // If we read the whole accumulator, then read a new
-            // 64 bit value from the buffer and reset the counter
-            if (m_accUsed == BITS) {
-                for (int i = 0; i < BYTES; i++) {
-                    std::uint8_t byte     = m_inBuff[m_read + i];
-                    std::uint8_t shiftNo  = (BYTES - i - 1) * BYTES;
-                    std::uint64_t shifted = static_cast<std::uint64_t>(byte)
-                                            << shiftNo;
-                    m_acc |= shifted;
-                }
-                m_read += BYTES;
-                m_accUsed = 0;
-            }
-
-            // Get the MSB bit
-            int bit = (m_acc >> (BITS - 1)) & 1;
-
-            // If current node is a leaf, then we have a full code
-            // so add the corresponding character to the output buffer
-            if (r->left == nullptr && r->right == nullptr) {
-                outBuff[bytesWrote] = m_dict[code];
-                m_processed++;
-                m_lastBytes++;
-                bytesWrote++;
-                break;
-            }
-
-            // If msb is 0, then traverse to the left subtree,
-            // otherwise go to the right
-            if (bit == 0) {
-                r = r->left;
-                code += '0';
-            } else {
-                r = r->right;
-                code += '1';
-            }
-
-            // Shift the accumulator to the left, so the next bit becomes MSB
-            m_acc <<= 1;
-            m_accUsed++;
+        decodeSymbols(outBuff + bytesWrote, count, refill);
+        if (m_checksum) {
+            m_crc = crc32c(m_crc, out + bytesWrote, count);
         }
+        bytesWrote += count;
+    }
 
-        // Start over for every code
-        r = m_tree;
+    m_processed += bytesWrote;
+    m_lastBytes = bytesWrote;
+    if (bytesWrote < numBytes) {
+        return -2; // Signal end of buffer and flush needed
     }
 
     return bytesWrote;
@@ -147,101 +176,330 @@ std::uint64_t HuffmanDecoder::getLastBytes() const {
     return m_lastBytes;
 }
 
+void HuffmanDecoder::setChecksum(bool enabled) {
+    m_checksum = enabled;
+}
+
+std::uint32_t HuffmanDecoder::getChecksum() const {
+    return m_crc;
+}
+
 HuffmanDecoder& HuffmanDecoder::operator=(HuffmanDecoder&& other) noexcept {
     m_dict         = std::move(other.m_dict);
+    m_dictReady    = other.m_dictReady;
     m_inBuff       = other.m_inBuff;
     m_inBuffSize   = other.m_inBuffSize;
     m_dictLoaded   = other.m_dictLoaded;
+    m_headerRead   = other.m_headerRead;
     m_originalSize = other.m_originalSize;
-    m_processed    = other.m_processed;
-    m_acc          = other.m_acc;
-    m_accUsed      = other.m_accUsed;
-    m_tree         = other.m_tree;
-    m_read         = other.m_read;
+    m_treeSize      = other.m_treeSize;
+    m_maxCodeLength = other.m_maxCodeLength;
+    m_processed     = other.m_processed;
+    m_bitPos        = other.m_bitPos;
     m_lastBytes    = other.m_lastBytes;
-
+    m_checksum     = other.m_checksum;
+    m_crc          = other.m_crc;
+    std::copy(std::begin(other.m_codes), std::end(other.m_codes), m_codes);
+    std::copy(&other.m_tree[0][0], &other.m_tree[0][0] + m_treeSize * 2,
+              &m_tree[0][0]);
+    std::copy(std::begin(other.m_table), std::end(other.m_table), m_table);
+
+    other.m_dictReady    = false;
     other.m_inBuff       = nullptr;
     other.m_inBuffSize   = 0;
     other.m_dictLoaded   = false;
+    other.m_headerRead   = false;
     other.m_originalSize = 0;
+    other.m_treeSize     = 0;
     other.m_processed    = 0;
-    other.m_acc          = 0;
-    other.m_accUsed      = 0;
-    other.m_tree         = nullptr;
-    other.m_read         = 0;
+    other.m_bitPos       = 0;
     other.m_lastBytes    = 0;
+    other.m_checksum     = false;
+    other.m_crc          = 0;
 
     return *this;
 }
 
-HuffmanNode* HuffmanDecoder::generateTreeFromDictionary() {
-    HuffmanNode* root = new HuffmanNode;
-    HuffmanNode* r    = root;
-    root->frequency   = 0;
-    root->symbol      = HuffmanNode::NO_SYMBOL;
-    root->left        = nullptr;
-    root->right       = nullptr;
-
-    for (const auto& it : m_dict) {
-        std::string code = it.first;
-        while (!code.empty()) {
-            if (code[0] == '0') {
-                if (r->left == nullptr) {
-                    r->left            = new HuffmanNode;
-                    r->left->frequency = 0;
-                    r->left->symbol    = HuffmanNode::NO_SYMBOL;
-                    r->left->left      = nullptr;
-                    r->left->right     = nullptr;
-                }
+void HuffmanDecoder::decodeSymbols(char* outBuff, std::uint64_t count,
+                                   Kernels::RefillFn refill) {
+    const std::uint64_t inBits = m_inBuffSize * BYTES;
+    const unsigned int shift   = BITS - TABLE_BITS;
+    const unsigned int step    = std::max(m_maxCodeLength, TABLE_BITS);
+    std::uint64_t done         = 0;
+
+    while (done < count) {
+        // Every lookup reads one word at m_bitPos and takes at most step
+        // bits, and every store writes MAX_SYMBOLS bytes. This many lookups
+        // stay inside both buffers, so they need no checks.
+        std::uint64_t lookups  = (count - done) / MAX_SYMBOLS;
+        std::uint64_t lastRead = inBits >= BITS ? inBits - BITS : 0;
+        if (m_maxCodeLength > BITS - BYTES || inBits < BITS ||
+            m_bitPos > lastRead) {
+            lookups = 0; // The whole code may not be in one word
+        } else {
+            lookups = std::min(lookups, (lastRead - m_bitPos) / step + 1);
+        }
 
-                r = r->left;
+        for (std::uint64_t i = 0; i < lookups; i++) {
+            std::uint64_t word =
+                refill(m_inBuff + m_bitPos / BYTES) << (m_bitPos % BYTES);
+            const Entry& entry = m_table[word >> shift];
+
+            if (entry.count != 0) {
+                // Several whole codes at once
+                std::memcpy(outBuff + done, entry.symbols, MAX_SYMBOLS);
+                done += entry.count;
+                m_bitPos += entry.bits;
             } else {
-                if (r->right == nullptr) {
-                    r->right            = new HuffmanNode;
-                    r->right->frequency = 0;
-                    r->right->symbol    = HuffmanNode::NO_SYMBOL;
-                    r->right->left      = nullptr;
-                    r->right->right     = nullptr;
+                outBuff[done++] = decodeLong(word);
+            }
+        }
+
+        if (lookups == 0) {
+            // Near the end of the input or the output, one symbol at a time
+            outBuff[done++] = decodeChecked(refill);
+        }
+    }
+}
+
+char HuffmanDecoder::decodeLong(std::uint64_t word) {
+    // Walk down the tree with the bits of the word, which holds the whole
+    // code. The tree may be incomplete if the codes were loaded.
+    int node = 0;
+    for (unsigned int i = 0;; i++) {
+        int bit   = (word >> (BITS - 1 - i)) & 1;
+        int child = m_tree[node][bit];
+        if (child == 0) {
+            throw std::runtime_error("Invalid code in stream");
+        }
+
+        if (child < 0) {
+            m_bitPos += i + 1;
+            return static_cast<char>(~child);
+        }
+
+        node = child;
+    }
+}
+
+char HuffmanDecoder::decodeChecked(Kernels::RefillFn refill) {
+    const std::uint64_t inBits = m_inBuffSize * BYTES;
+    if (m_bitPos >= inBits) {
+        throw std::runtime_error("Truncated stream");
+    }
+
+    // The missing bytes after the end of the input read as zero
+    std::uint64_t byte = m_bitPos / BYTES;
+    std::uint64_t word = 0;
+    if (m_inBuffSize - byte >= BYTES) {
+        word = refill(m_inBuff + byte);
+    } else {
+        for (std::uint64_t i = byte; i < m_inBuffSize; i++) {
+            word |= static_cast<std::uint64_t>(
+                        static_cast<unsigned char>(m_inBuff[i]))
+                    << ((BYTES - 1 - (i - byte)) * BYTES);
+        }
+    }
+    word <<= m_bitPos % BYTES;
+
+    const Entry& entry = m_table[word >> (BITS - TABLE_BITS)];
+    char symbol;
+    if (entry.count != 0) {
+        symbol = static_cast<char>(entry.symbols[0]);
+        m_bitPos += entry.firstBits;
+    } else if (m_maxCodeLength <= BITS - BYTES) {
+        symbol = decodeLong(word);
+    } else {
+        // Codes that may not fit the word are read one bit at a time
+        int node = 0;
+        while (true) {
+            if (m_bitPos >= inBits) {
+                throw std::runtime_error("Truncated stream");
+            }
+
+            unsigned char in = static_cast<unsigned char>(
+                m_inBuff[m_bitPos / BYTES]);
+            int bit   = (in >> (BYTES - 1 - m_bitPos % BYTES)) & 1;
+            int child = m_tree[node][bit];
+            m_bitPos++;
+            if (child == 0) {
+                throw std::runtime_error("Invalid code in stream");
+            }
+
+            if (child < 0) {
+                symbol = static_cast<char>(~child);
+                break;
+            }
+
+            node = child;
+        }
+    }
+
+    // The code must not run into the zero padding after the input
+    if (m_bitPos > inBits) {
+        throw std::runtime_error("Truncated stream");
+    }
+
+    return symbol;
+}
+
+void HuffmanDecoder::generateTables() {
+    constexpr unsigned int SIZE = 1u << TABLE_BITS;
+
+    // Codes that fit the table index first, one symbol per entry
+    for (unsigned int i = 0; i < SIZE; i++) {
+        m_table[i].count     = 0;
+        m_table[i].bits      = 0;
+        m_table[i].firstBits = 0;
+    }
+
+    for (int i = 0; i < FREQ_SIZE; i++) {
+        const Code& code = m_codes[i];
+        if (code.length == 0 || code.length > TABLE_BITS) {
+            continue;
+        }
+
+        unsigned int first = static_cast<unsigned int>(code.bits)
+                             << (TABLE_BITS - code.length);
+        for (unsigned int j = 0; j < (1u << (TABLE_BITS - code.length)); j++) {
+            Entry& entry     = m_table[first + j];
+            entry.symbols[0] = static_cast<unsigned char>(i);
+            entry.count      = 1;
+            entry.bits       = code.length;
+            entry.firstBits  = code.length;
+        }
+    }
+
+    // Then append the codes that follow in the rest of the index bits
+    for (unsigned int i = 0; i < SIZE; i++) {
+        Entry& entry = m_table[i];
+        if (entry.count == 0) {
+            continue;
+        }
+
+        while (entry.count < MAX_SYMBOLS) {
+            unsigned int rest = (i << entry.bits) & (SIZE - 1);
+            const Entry& next = m_table[rest];
+            // The next code must end inside the index, not in padding
+            if (next.firstBits == 0 ||
+                entry.bits + next.firstBits > TABLE_BITS) {
+                break;
+            }
+
+            entry.symbols[entry.count++] = next.symbols[0];
+            entry.bits += next.firstBits;
+        }
+    }
+}
+
+void HuffmanDecoder::generateTreeFromCodes() {
+    m_tree[0][0]    = 0;
+    m_tree[0][1]    = 0;
+    m_treeSize      = 1;
+    m_maxCodeLength = 1;
+
+    for (int i = 0; i < FREQ_SIZE; i++) {
+        const Code& code = m_codes[i];
+        if (code.length == 0) {
+            continue;
+        }
+
+        m_maxCodeLength = std::max(m_maxCodeLength, code.length);
+
+        // Walk down the tree, creating the inner nodes on the way
+        int node = 0;
+        for (unsigned int j = code.length - 1; j > 0; j--) {
+            int bit   = (code.bits >> j) & 1;
+            int child = m_tree[node][bit];
+            if (child < 0) {
+                throw std::runtime_error("Codes are not prefix free");
+            }
+
+            if (child == 0) {
+                if (m_treeSize == FREQ_SIZE - 1) {
+                    throw std::runtime_error("Codes are not prefix free");
                 }
 
-                r = r->right;
+                child                = m_treeSize++;
+                m_tree[child][0]     = 0;
+                m_tree[child][1]     = 0;
+                m_tree[node][bit]    = child;
             }
 
-            code.erase(0, 1);
+            node = child;
         }
 
-        r->symbol = it.second;
-        r         = root;
+        int bit = code.bits & 1;
+        if (m_tree[node][bit] != 0) {
+            throw std::runtime_error("Codes are not prefix free");
+        }
+        m_tree[node][bit] = ~i;
     }
 
-    return root;
+    generateTables();
 }
 
 void HuffmanDecoder::loadDictionaryFromStream() {
+    constexpr std::uint64_t SIZES = sizeof(std::uint64_t) +
+                                    sizeof(std::uint16_t);
+    if (m_inBuffSize < SIZES) {
+        throw std::runtime_error("Truncated stream header");
+    }
+
     // Read original size
-    m_originalSize = reinterpret_cast<const unsigned long*>(m_inBuff)[0];
-    m_inBuff += sizeof(unsigned long);
-    // Read dictionary szie
-    std::uint8_t dictSize = reinterpret_cast<const std::uint8_t*>(m_inBuff)[0];
-    m_inBuff += sizeof(std::uint8_t);
+    m_originalSize = readLE64(m_inBuff);
+    // Read dictionary size
+    std::uint16_t dictSize = readLE16(m_inBuff + sizeof(std::uint64_t));
+    m_inBuff += SIZES;
+    m_inBuffSize -= SIZES;
+
+    // Streams coded with a loaded dictionary may leave it out
+    if (dictSize == 0 && m_dictLoaded) {
+        return;
+    }
+
+    if (dictSize > FREQ_SIZE) {
+        throw std::runtime_error("Invalid dictionary size in stream header");
+    }
+
     // Read dictionary
+    Code codes[FREQ_SIZE] = {};
     for (unsigned i = 0; i < dictSize; i++) {
-        // Read code size
-        std::uint8_t codeSize =
-            reinterpret_cast<const std::uint8_t*>(m_inBuff)[0];
-        m_inBuff += sizeof(std::uint8_t);
+        if (m_inBuffSize < 2) {
+            throw std::runtime_error("Truncated stream header");
+        }
+
+        // Read byte and code size
+        unsigned char symbol  = static_cast<unsigned char>(m_inBuff[0]);
+        std::uint8_t codeSize = static_cast<std::uint8_t>(m_inBuff[1]);
+        m_inBuff += 2;
+        m_inBuffSize -= 2;
 
-        // Read code
-        std::string code;
+        if (codeSize == 0 || codeSize > BITS) {
+            throw std::runtime_error("Invalid code size in stream header");
+        }
+
+        unsigned int codeBytes = (codeSize + BYTES - 1) / BYTES;
+        if (m_inBuffSize < codeBytes) {
+            throw std::runtime_error("Truncated stream header");
+        }
+
+        // Read code, packed from the MSB
+        std::uint64_t bits = 0;
         for (unsigned j = 0; j < codeSize; j++) {
-            code += reinterpret_cast<const char*>(m_inBuff)[0];
-            m_inBuff++;
+            std::uint8_t byte = m_inBuff[j / BYTES];
+            bits = (bits << 1) | ((byte >> (BYTES - 1 - j % BYTES)) & 1);
         }
+        m_inBuff += codeBytes;
+        m_inBuffSize -= codeBytes;
 
-        // Read byte and assign to dictionary
-        m_dict[code] = reinterpret_cast<const unsigned char*>(m_inBuff)[0];
-        m_inBuff++;
+        codes[symbol].bits   = bits;
+        codes[symbol].length = codeSize;
     }
+
+    std::copy(std::begin(codes), std::end(codes), m_codes);
+    m_dictReady = false;
+    m_treeSize  = 0;
 }
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,391 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <IoBackend.hpp>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #define HFM_POSITIONAL_IO
+    #include <condition_variable>
+    #include <deque>
+    #include <mutex>
+    #include <thread>
+    #include <vector>
+    #include <cerrno>
+    #include <unistd.h>
+#endif
+
+#if defined(__linux__) && defined(__has_include)
+    #if __has_include(<linux/io_uring.h>)
+        #define HFM_IO_URING
+        #include <linux/io_uring.h>
+        #include <sys/mman.h>
+        #include <sys/syscall.h>
+        #include <algorithm>
+        #include <stdexcept>
+        #include <string>
+    #endif
+#endif
+
+#ifdef HFM_POSITIONAL_IO
+
+namespace {
+
+// Workers of the thread pool; enough to keep a read and a write going
+constexpr unsigned int THREADS = 2;
+
+class ThreadBackend : public hfm::IoBackend {
+public:
+    ThreadBackend() : m_stop(false) {
+        for (unsigned int i = 0; i < THREADS; i++) {
+            m_threads.emplace_back(&ThreadBackend::work, this);
+        }
+    }
+
+    ~ThreadBackend() override {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_work.notify_all();
+        for (auto& thread : m_threads) {
+            thread.join();
+        }
+    }
+
+    const char* getName() const override {
+        return "threads";
+    }
+
+    void submit(const Request& request) override {
+        m_batch.push_back(request);
+    }
+
+    void flush() override {
+        if (m_batch.empty()) {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_requests.insert(m_requests.end(), m_batch.begin(),
+                              m_batch.end());
+        }
+        m_batch.clear();
+        m_work.notify_all();
+    }
+
+    Completion wait() override {
+        flush();
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this]() { return !m_completions.empty(); });
+        Completion completion = m_completions.front();
+        m_completions.pop_front();
+
+        return completion;
+    }
+
+private:
+    void work() {
+        while (true) {
+            Request request;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_work.wait(lock, [this]() {
+                    return m_stop || !m_requests.empty();
+                });
+                if (m_stop) {
+                    return;
+                }
+
+                request = m_requests.front();
+                m_requests.pop_front();
+            }
+
+            ssize_t result =
+                request.write
+                    ? pwrite(request.fd, request.buffer, request.size,
+                             static_cast<off_t>(request.offset))
+                    : pread(request.fd, request.buffer, request.size,
+                            static_cast<off_t>(request.offset));
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_completions.push_back(
+                    {request.tag, result < 0 ? -errno : result});
+            }
+            m_done.notify_one();
+        }
+    }
+
+private:
+    std::vector<Request> m_batch; // Submitted but not yet flushed
+    std::mutex m_mutex;           // Guards everything below
+    std::condition_variable m_work;
+    std::condition_variable m_done;
+    std::deque<Request> m_requests;
+    std::deque<Completion> m_completions;
+    bool m_stop;
+    std::vector<std::thread> m_threads;
+};
+
+#ifdef HFM_IO_URING
+
+// The rings are shared with the kernel, which reads the submission tail and
+// writes the completion tail concurrently
+template <typename T>
+T loadAcquire(const T* value) {
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+template <typename T>
+void storeRelease(T* value, T newValue) {
+    __atomic_store_n(value, newValue, __ATOMIC_RELEASE);
+}
+
+class UringBackend : public hfm::IoBackend {
+public:
+    // Returns nullptr if the kernel has no usable io_uring
+    static std::unique_ptr<UringBackend> create(unsigned int depth) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        int fd = static_cast<int>(syscall(__NR_io_uring_setup, depth, &params));
+        if (fd < 0) {
+            return nullptr;
+        }
+
+        // IORING_OP_READ and IORING_OP_WRITE came with this feature (5.6)
+        if ((params.features & IORING_FEAT_RW_CUR_POS) == 0) {
+            close(fd);
+            return nullptr;
+        }
+
+        std::unique_ptr<UringBackend> backend(new UringBackend(fd, params));
+        if (!backend->map()) {
+            return nullptr;
+        }
+
+        return backend;
+    }
+
+    ~UringBackend() override {
+        if (m_sqes != nullptr) {
+            munmap(m_sqes, m_sqesSize);
+        }
+        if (m_cqRing != nullptr && m_cqRing != m_sqRing) {
+            munmap(m_cqRing, m_cqRingSize);
+        }
+        if (m_sqRing != nullptr) {
+            munmap(m_sqRing, m_sqRingSize);
+        }
+        close(m_fd);
+    }
+
+    const char* getName() const override {
+        return "io_uring";
+    }
+
+    void submit(const Request& request) override {
+        // Entries stay in the ring until the kernel has read them, which it
+        // does while entering, so a full ring is handed over first
+        const unsigned int tail  = *m_sqTail;
+        if (tail - loadAcquire(m_sqHead) >= *m_sqEntries) {
+            enter(0);
+            if (tail - loadAcquire(m_sqHead) >= *m_sqEntries) {
+                throw std::runtime_error("io_uring submission queue is full");
+            }
+        }
+        const unsigned int index = tail & *m_sqMask;
+
+        io_uring_sqe* sqe = &m_sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode    = request.write ? IORING_OP_WRITE : IORING_OP_READ;
+        sqe->fd        = request.fd;
+        sqe->addr      = reinterpret_cast<std::uint64_t>(request.buffer);
+        sqe->len       = static_cast<std::uint32_t>(request.size);
+        sqe->off       = request.offset;
+        sqe->user_data = request.tag;
+
+        m_sqArray[index] = index;
+        storeRelease(m_sqTail, tail + 1);
+        m_unsubmitted++;
+    }
+
+    void flush() override {
+        enter(0);
+    }
+
+    Completion wait() override {
+        while (true) {
+            const unsigned int head = *m_cqHead;
+            if (head != loadAcquire(m_cqTail)) {
+                const io_uring_cqe& cqe = m_cqes[head & *m_cqMask];
+                Completion completion   = {cqe.user_data, cqe.res};
+                storeRelease(m_cqHead, head + 1);
+                return completion;
+            }
+
+            enter(1);
+        }
+    }
+
+private:
+    UringBackend(int fd, const io_uring_params& params)
+        : m_fd(fd), m_params(params), m_sqRing(nullptr), m_cqRing(nullptr),
+          m_sqes(nullptr), m_unsubmitted(0) {}
+
+    bool map() {
+        const io_uring_params& p = m_params;
+        m_sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+        m_cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        m_sqesSize   = p.sq_entries * sizeof(io_uring_sqe);
+
+        // Newer kernels map both rings with one call
+        const bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) {
+            m_sqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+            m_cqRingSize = m_sqRingSize;
+        }
+
+        void* sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, m_fd,
+                            IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED) {
+            return false;
+        }
+        m_sqRing = static_cast<char*>(sqRing);
+
+        if (single) {
+            m_cqRing = m_sqRing;
+        } else {
+            void* cqRing = mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_POPULATE, m_fd,
+                                IORING_OFF_CQ_RING);
+            if (cqRing == MAP_FAILED) {
+                return false;
+            }
+            m_cqRing = static_cast<char*>(cqRing);
+        }
+
+        void* sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            return false;
+        }
+        m_sqes = static_cast<io_uring_sqe*>(sqes);
+
+        m_sqHead  = reinterpret_cast<unsigned int*>(m_sqRing + p.sq_off.head);
+        m_sqTail  = reinterpret_cast<unsigned int*>(m_sqRing + p.sq_off.tail);
+        m_sqMask  = reinterpret_cast<unsigned int*>(m_sqRing +
+                                                    p.sq_off.ring_mask);
+        m_sqArray = reinterpret_cast<unsigned int*>(m_sqRing + p.sq_off.array);
+        m_cqHead  = reinterpret_cast<unsigned int*>(m_cqRing + p.cq_off.head);
+        m_cqTail  = reinterpret_cast<unsigned int*>(m_cqRing + p.cq_off.tail);
+        m_cqMask  = reinterpret_cast<unsigned int*>(m_cqRing +
+                                                    p.cq_off.ring_mask);
+        m_cqes    = reinterpret_cast<io_uring_cqe*>(m_cqRing + p.cq_off.cqes);
+        m_sqEntries =
+            reinterpret_cast<unsigned int*>(m_sqRing + p.sq_off.ring_entries);
+
+        return true;
+    }
+
+    // Submits the queued entries and waits for minComplete completions
+    void enter(unsigned int minComplete) {
+        while (m_unsubmitted > 0 || minComplete > 0) {
+            long result = syscall(__NR_io_uring_enter, m_fd, m_unsubmitted,
+                                  minComplete,
+                                  minComplete > 0 ? IORING_ENTER_GETEVENTS
+                                                  : 0,
+                                  nullptr, 0);
+            if (result < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error(std::string("io_uring_enter: ") +
+                                         std::strerror(errno));
+            }
+
+            m_unsubmitted -= static_cast<unsigned int>(result);
+            if (minComplete > 0) {
+                return;
+            }
+        }
+    }
+
+private:
+    int m_fd;
+    io_uring_params m_params;
+    char* m_sqRing;
+    char* m_cqRing;
+    io_uring_sqe* m_sqes;
+    std::size_t m_sqRingSize;
+    std::size_t m_cqRingSize;
+    std::size_t m_sqesSize;
+
+    // Fields of the rings
+    unsigned int* m_sqHead;
+    unsigned int* m_sqTail;
+    unsigned int* m_sqEntries;
+    unsigned int* m_sqMask;
+    unsigned int* m_sqArray;
+    unsigned int* m_cqHead;
+    unsigned int* m_cqTail;
+    unsigned int* m_cqMask;
+    io_uring_cqe* m_cqes;
+
+    unsigned int m_unsubmitted; // Entries not yet passed to the kernel
+};
+
+#endif
+
+}
+
+#endif
+
+namespace hfm {
+
+std::unique_ptr<IoBackend> IoBackend::create(unsigned int depth) {
+#ifdef HFM_POSITIONAL_IO
+    const char* forced = std::getenv("HFM_IO");
+    const bool threads =
+        forced != nullptr && std::strcmp(forced, "threads") == 0;
+
+#ifdef HFM_IO_URING
+    if (!threads) {
+        std::unique_ptr<UringBackend> uring = UringBackend::create(depth);
+        if (uring != nullptr) {
+            return uring;
+        }
+    }
+#endif
+
+    (void)threads;
+    (void)depth;
+    return std::make_unique<ThreadBackend>();
+#else
+    (void)depth;
+    return nullptr;
+#endif
+}
+
+bool IoBackend::isDirectWanted(std::uint64_t size) {
+    const char* direct = std::getenv("HFM_DIRECT");
+    return direct != nullptr && std::strcmp(direct, "1") == 0 &&
+           size >= DIRECT_THRESHOLD;
+}
+
+}
@@ -0,0 +1,342 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <JobPool.hpp>
+#include <BlockCoder.hpp>
+#include <BlockDecoder.hpp>
+#include <ContextPool.hpp>
+#include <ByteOrder.hpp>
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+
+namespace {
+
+// Output taken per call when decoding a single HuffmanCoder stream
+constexpr std::uint64_t STREAM_CHUNK = 1 << 17;
+
+}
+
+namespace hfm {
+
+struct JobPool::Job {
+    Operation operation;
+    std::vector<char> input;
+    Callback callback;
+    std::uint64_t segmentSize;
+    std::uint64_t maxBlockSize;
+    std::atomic<std::size_t> remaining; // Parts not yet finished
+
+    std::vector<std::vector<char>> segments; // Containers of the segments
+    bool container; // The input to decompress is a block container
+    std::vector<BlockDecoder::Block> blocks;
+    std::vector<std::size_t> firstBlocks; // Of every part, then the end
+    std::vector<char> output;
+
+    std::mutex errorMutex;
+    std::exception_ptr error; // First exception thrown by a part
+};
+
+JobPool::JobPool(unsigned int threads, unsigned int maxJobs)
+    : m_maxJobs(std::max(maxJobs, 1u)), m_segmentSize(SEGMENT_SIZE),
+      m_maxBlockSize(BlockFormat::MAX_BLOCK_SIZE), m_jobs(0), m_stop(false) {
+    if (threads == 0) {
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    for (unsigned int i = 0; i < threads; i++) {
+        m_threads.emplace_back(&JobPool::work, this);
+    }
+}
+
+JobPool::~JobPool() {
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_work.notify_all();
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+}
+
+unsigned int JobPool::getThreads() const {
+    return static_cast<unsigned int>(m_threads.size());
+}
+
+void JobPool::setSegmentSize(std::uint64_t size) {
+    if (size == 0) {
+        throw std::invalid_argument("Invalid segment size");
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_segmentSize = size;
+}
+
+void JobPool::setMaxBlockSize(std::uint64_t size) {
+    if (size < BlockSplitter::SEGMENT_SIZE ||
+        size > BlockFormat::MAX_BLOCK_SIZE) {
+        throw std::invalid_argument("Invalid block size");
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_maxBlockSize = size;
+}
+
+std::future<std::vector<char>> JobPool::submit(Operation operation,
+                                               std::vector<char> input) {
+    auto promise = std::make_shared<std::promise<std::vector<char>>>();
+    std::future<std::vector<char>> result = promise->get_future();
+    submit(operation, std::move(input),
+           [promise](std::vector<char> output, std::exception_ptr error) {
+               if (error) {
+                   promise->set_exception(error);
+               } else {
+                   promise->set_value(std::move(output));
+               }
+           });
+
+    return result;
+}
+
+void JobPool::submit(Operation operation, std::vector<char> input,
+                     Callback callback) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_room.wait(lock, [this]() { return m_jobs < m_maxJobs; });
+    enqueue(operation, std::move(input), std::move(callback));
+}
+
+bool JobPool::trySubmit(Operation operation, std::vector<char>&& input,
+                        Callback callback) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_jobs >= m_maxJobs) {
+        return false;
+    }
+
+    enqueue(operation, std::move(input), std::move(callback));
+    return true;
+}
+
+void JobPool::wait() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_room.wait(lock, [this]() { return m_jobs == 0; });
+}
+
+// Called with m_mutex held
+void JobPool::enqueue(Operation operation, std::vector<char>&& input,
+                      Callback&& callback) {
+    auto job       = std::make_shared<Job>();
+    job->operation    = operation;
+    job->input        = std::move(input);
+    job->callback     = std::move(callback);
+    job->segmentSize  = m_segmentSize;
+    job->maxBlockSize = m_maxBlockSize;
+    job->remaining    = 0;
+    job->container    = false;
+
+    m_jobs++;
+    m_tasks.push_back({job, PLAN});
+    m_work.notify_one();
+}
+
+void JobPool::work() {
+    for (;;) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_work.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+            if (m_tasks.empty()) {
+                return;
+            }
+
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+
+        if (task.part == PLAN) {
+            plan(task.job);
+        } else {
+            runPart(*task.job, task.part);
+            finishPart(task.job);
+        }
+    }
+}
+
+void JobPool::plan(const std::shared_ptr<Job>& job) {
+    std::size_t parts = 0;
+    try {
+        if (job->operation == COMPRESS) {
+            const std::uint64_t segment = job->segmentSize;
+            parts                       = static_cast<std::size_t>(
+                std::max<std::uint64_t>(
+                    (job->input.size() + segment - 1) / segment, 1));
+            job->segments.resize(parts);
+        } else if (BlockFormat::isContainer(job->input.data(),
+                                            job->input.size())) {
+            BlockDecoder decoder(job->input.data(), job->input.size());
+            job->container = true;
+            job->blocks    = decoder.getBlocks();
+            job->output.resize(decoder.getOriginalSize());
+
+            // Runs of blocks with about a segment of output
+            std::uint64_t size = 0;
+            job->firstBlocks.push_back(0);
+            for (std::size_t i = 0; i < job->blocks.size(); i++) {
+                size += job->blocks[i].originalSize;
+                if (size >= job->segmentSize ||
+                    i + 1 == job->blocks.size()) {
+                    job->firstBlocks.push_back(i + 1);
+                    size = 0;
+                }
+            }
+            parts = job->firstBlocks.size() - 1;
+        } else {
+            parts = 1;
+        }
+    } catch (...) {
+        job->error = std::current_exception();
+        parts      = 0;
+    }
+
+    if (parts == 0) {
+        complete(*job);
+        return;
+    }
+
+    // The other parts go to idle workers; this one takes the first
+    job->remaining = parts;
+    if (parts > 1) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (std::size_t i = 1; i < parts; i++) {
+                m_tasks.push_back({job, i});
+            }
+        }
+        m_work.notify_all();
+    }
+
+    runPart(*job, 0);
+    finishPart(job);
+}
+
+void JobPool::runPart(Job& job, std::size_t part) {
+    try {
+        if (job.operation == COMPRESS) {
+            const std::uint64_t offset = part * job.segmentSize;
+            BlockCoder coder(job.input.data() + offset,
+                             std::min(job.segmentSize,
+                                      job.input.size() - offset));
+            coder.setMaxBlockSize(job.maxBlockSize);
+
+            std::vector<char>& segment = job.segments[part];
+            std::uint64_t written      = 0;
+            std::int64_t chunk         = 0;
+            for (;;) {
+                segment.resize(written + BlockCoder::MAX_OUTPUT);
+                chunk = coder.compress(segment.data() + written,
+                                       BlockCoder::MAX_OUTPUT);
+                if (chunk < 0) {
+                    break;
+                }
+
+                written += chunk;
+            }
+            segment.resize(written);
+        } else if (job.container) {
+            HuffmanDecoder& decoder = ContextPool::getDecoder(nullptr, 0);
+            for (std::size_t i = job.firstBlocks[part];
+                 i < job.firstBlocks[part + 1]; i++) {
+                const BlockDecoder::Block& block = job.blocks[i];
+                BlockDecoder::decodeBlock(job.input.data(), block,
+                                          job.output.data() +
+                                              block.outputOffset,
+                                          decoder);
+            }
+        } else {
+            HuffmanDecoder& decoder =
+                ContextPool::getDecoder(job.input.data(), job.input.size());
+            std::uint64_t done = 0;
+            for (;;) {
+                job.output.resize(done + STREAM_CHUNK);
+                std::int64_t written =
+                    decoder.decompress(job.output.data() + done, STREAM_CHUNK);
+                if (written == -2) {
+                    done += decoder.getLastBytes();
+                }
+                if (written < 0) {
+                    break;
+                }
+
+                done += written;
+            }
+            job.output.resize(done);
+        }
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(job.errorMutex);
+        if (!job.error) {
+            job.error = std::current_exception();
+        }
+    }
+}
+
+void JobPool::finishPart(const std::shared_ptr<Job>& job) {
+    if (--job->remaining == 0) {
+        complete(*job);
+    }
+}
+
+void JobPool::complete(Job& job) {
+    std::vector<char> output;
+    if (!job.error && job.operation == COMPRESS) {
+        // The segments become one container: the first header, the blocks
+        // of every segment, and an end with the size of the whole input
+        output = std::move(job.segments[0]);
+        if (job.segments.size() > 1) {
+            output.resize(output.size() - BlockFormat::END_SIZE);
+            for (std::size_t i = 1; i < job.segments.size(); i++) {
+                const std::vector<char>& segment = job.segments[i];
+                output.insert(output.end(),
+                              segment.begin() + BlockFormat::HEADER_SIZE,
+                              segment.end() - BlockFormat::END_SIZE);
+            }
+
+            char end[BlockFormat::END_SIZE];
+            end[0] = static_cast<char>(BlockFormat::END);
+            end[1] = 0; // Flags
+            writeLE64(end + 2, job.input.size());
+            output.insert(output.end(), end, end + BlockFormat::END_SIZE);
+        }
+    } else if (!job.error) {
+        output = std::move(job.output);
+    }
+
+    // Memory of the job is given back before the caller gets the result
+    job.input    = std::vector<char>();
+    job.segments = std::vector<std::vector<char>>();
+    job.blocks   = std::vector<BlockDecoder::Block>();
+    try {
+        job.callback(std::move(output), job.error);
+    } catch (...) {
+    }
+    job.callback = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs--;
+    }
+    m_room.notify_all();
+}
+
+}
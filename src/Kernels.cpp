@@ -0,0 +1,291 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <Kernels.hpp>
+#include <CpuFeatures.hpp>
+#include <cstdlib>
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) &&                               \
+    (defined(__x86_64__) || defined(__i386__))
+    #define HFM_X86_DISPATCH
+    #include <immintrin.h>
+    #define HFM_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+    #define HFM_INLINE inline __attribute__((always_inline))
+#else
+    #define HFM_INLINE inline
+#endif
+
+namespace {
+
+constexpr int FREQ_SIZE = 256;
+constexpr int BYTES     = 8;
+constexpr int BITS      = 64;
+constexpr int TABLES    = 4;
+// Sub-counters are 32 bit, so they are merged before they can overflow
+constexpr std::uint64_t HISTOGRAM_CHUNK = 1ULL << 30;
+// Reflected CRC32C polynomial
+constexpr std::uint32_t CRC32C_POLY = 0x82F63B78;
+
+// Tables for the slicing-by-8 CRC, where table[k][b] is the CRC of byte b
+// followed by k zero bytes
+struct CrcTables {
+    std::uint32_t table[BYTES][FREQ_SIZE];
+
+    constexpr CrcTables() : table() {
+        for (int i = 0; i < FREQ_SIZE; i++) {
+            std::uint32_t crc = i;
+            for (int j = 0; j < BYTES; j++) {
+                crc = (crc >> 1) ^ ((crc & 1) != 0 ? CRC32C_POLY : 0);
+            }
+            table[0][i] = crc;
+        }
+
+        for (int k = 1; k < BYTES; k++) {
+            for (int i = 0; i < FREQ_SIZE; i++) {
+                std::uint32_t prev = table[k - 1][i];
+                table[k][i]        = (prev >> 8) ^ table[0][prev & 0xFF];
+            }
+        }
+    }
+};
+
+constexpr CrcTables CRC_TABLES;
+
+
+HFM_INLINE std::uint64_t toBigEndian(std::uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+    #if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    return __builtin_bswap64(word);
+    #else
+    return word;
+    #endif
+#else
+    unsigned char bytes[BYTES];
+    for (int i = 0; i < BYTES; i++) {
+        bytes[i] = (word >> ((BYTES - i - 1) * BYTES)) & 0xFF;
+    }
+    std::memcpy(&word, bytes, BYTES);
+    return word;
+#endif
+}
+
+HFM_INLINE void storeWord(char* out, std::uint64_t word) {
+    word = toBigEndian(word);
+    std::memcpy(out, &word, BYTES);
+}
+
+std::uint64_t refillScalar(const char* in) {
+    std::uint64_t word;
+    std::memcpy(&word, in, BYTES);
+    return toBigEndian(word);
+}
+
+HFM_INLINE void countWord(std::uint32_t (*tables)[FREQ_SIZE],
+                          std::uint64_t word) {
+    tables[0][word & 0xFF]++;
+    tables[1][(word >> 8) & 0xFF]++;
+    tables[2][(word >> 16) & 0xFF]++;
+    tables[3][(word >> 24) & 0xFF]++;
+    tables[0][(word >> 32) & 0xFF]++;
+    tables[1][(word >> 40) & 0xFF]++;
+    tables[2][(word >> 48) & 0xFF]++;
+    tables[3][(word >> 56) & 0xFF]++;
+}
+
+HFM_INLINE void mergeTables(std::uint32_t (*tables)[FREQ_SIZE],
+                            std::uint64_t* counts) {
+    for (int i = 0; i < FREQ_SIZE; i++) {
+        counts[i] += static_cast<std::uint64_t>(tables[0][i]) + tables[1][i] +
+                     tables[2][i] + tables[3][i];
+    }
+}
+
+// There are no ISA variants of the histogram or the refill. Eight and
+// sixteen tables, and AVX2 versions taking 32 bytes per load, were at best
+// as fast as these four tables on random, text and single-symbol data and
+// up to a third slower on text: the loop is bound by the increments, which
+// wider loads do not reduce. The refill is a load and a byte swap, which
+// movbe would not make cheaper.
+void histogramScalar(const unsigned char* data, std::uint64_t size,
+                     std::uint64_t* counts) {
+    while (size > 0) {
+        std::uint64_t n = size < HISTOGRAM_CHUNK ? size : HISTOGRAM_CHUNK;
+        // Counting into several tables avoids stalls on runs of one byte
+        std::uint32_t tables[TABLES][FREQ_SIZE] = {};
+
+        std::uint64_t i = 0;
+        for (; i + BYTES <= n; i += BYTES) {
+            std::uint64_t word;
+            std::memcpy(&word, data + i, BYTES);
+            countWord(tables, word);
+        }
+        for (; i < n; i++) {
+            tables[0][data[i]]++;
+        }
+
+        mergeTables(tables, counts);
+        data += n;
+        size -= n;
+    }
+}
+
+HFM_INLINE std::uint64_t encodeBody(const unsigned char* in,
+                                    std::uint64_t count,
+                                    const hfm::Code* codes,
+                                    std::uint64_t& acc, unsigned int& accUsed,
+                                    char* out) {
+    std::uint64_t a    = acc;
+    unsigned int used  = accUsed;
+    std::uint64_t wrote = 0;
+
+    for (std::uint64_t i = 0; i < count; i++) {
+        const hfm::Code& code = codes[in[i]];
+
+        if (used + code.length < BITS) {
+            a = (a << code.length) | code.bits;
+            used += code.length;
+        } else {
+            // Fill the accumulator with the high bits of the code, flush it
+            // and keep the remaining low bits
+            unsigned int rest = used + code.length - BITS;
+            unsigned int take = code.length - rest;
+            std::uint64_t word =
+                take == BITS ? code.bits : (a << take) | (code.bits >> rest);
+            storeWord(out + wrote, word);
+            wrote += BYTES;
+
+            a    = code.bits & ((std::uint64_t(1) << rest) - 1);
+            used = rest;
+        }
+    }
+
+    acc     = a;
+    accUsed = used;
+    return wrote;
+}
+
+std::uint32_t crc32cScalar(std::uint32_t crc, const unsigned char* data,
+                          std::uint64_t size) {
+    const auto& t = CRC_TABLES.table;
+    std::uint32_t c = ~crc;
+
+    std::uint64_t i = 0;
+    for (; i + BYTES <= size; i += BYTES) {
+        const unsigned char* p = data + i;
+        std::uint32_t low = c ^ (static_cast<std::uint32_t>(p[0]) |
+                                 static_cast<std::uint32_t>(p[1]) << 8 |
+                                 static_cast<std::uint32_t>(p[2]) << 16 |
+                                 static_cast<std::uint32_t>(p[3]) << 24);
+        c = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^
+            t[5][(low >> 16) & 0xFF] ^ t[4][low >> 24] ^ t[3][p[4]] ^
+            t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+    }
+    for (; i < size; i++) {
+        c = (c >> 8) ^ t[0][(c ^ data[i]) & 0xFF];
+    }
+
+    return ~c;
+}
+
+std::uint64_t encodeScalar(const unsigned char* in, std::uint64_t count,
+                           const hfm::Code* codes, std::uint64_t& acc,
+                           unsigned int& accUsed, char* out) {
+    return encodeBody(in, count, codes, acc, accUsed, out);
+}
+
+#ifdef HFM_X86_DISPATCH
+
+HFM_TARGET("sse4.2,popcnt")
+std::uint32_t crc32cSse42(std::uint32_t crc, const unsigned char* data,
+                          std::uint64_t size) {
+    // The crc32 instruction takes 8 bytes per step, which is far faster than
+    // the coder, so one dependency chain is enough
+    std::uint64_t c = ~crc;
+
+    std::uint64_t i = 0;
+    for (; i + BYTES <= size; i += BYTES) {
+        std::uint64_t word;
+        std::memcpy(&word, data + i, BYTES);
+    #if defined(__x86_64__)
+        c = _mm_crc32_u64(c, word);
+    #else
+        c = _mm_crc32_u32(static_cast<std::uint32_t>(c),
+                          static_cast<std::uint32_t>(word));
+        c = _mm_crc32_u32(static_cast<std::uint32_t>(c),
+                          static_cast<std::uint32_t>(word >> 32));
+    #endif
+    }
+    for (; i < size; i++) {
+        c = _mm_crc32_u8(static_cast<std::uint32_t>(c), data[i]);
+    }
+
+    return ~static_cast<std::uint32_t>(c);
+}
+
+    #if defined(__x86_64__)
+
+HFM_TARGET("bmi,bmi2")
+std::uint64_t encodeBmi2(const unsigned char* in, std::uint64_t count,
+                         const hfm::Code* codes, std::uint64_t& acc,
+                         unsigned int& accUsed, char* out) {
+    // Under this target the shifts by a register become shlx and shrx,
+    // which leave the flags alone, and the mask of the low bits of a split
+    // code becomes bzhi
+    return encodeBody(in, count, codes, acc, accUsed, out);
+}
+
+    #endif
+
+#endif
+
+}
+
+namespace hfm {
+
+const Kernels& Kernels::get() {
+    static const Kernels kernels;
+    return kernels;
+}
+
+Kernels::Kernels()
+    : histogram(histogramScalar), encode(encodeScalar), refill(refillScalar),
+      crc32c(crc32cScalar), histogramName("scalar"), encodeName("scalar"),
+      refillName("scalar"), crc32cName("scalar") {
+    const char* forced = std::getenv("HFM_DISPATCH");
+    if (forced != nullptr && std::strcmp(forced, "scalar") == 0) {
+        return;
+    }
+
+#ifdef HFM_X86_DISPATCH
+    const CpuFeatures& cpu = CpuFeatures::get();
+
+    #if defined(__x86_64__)
+    if (cpu.bmi2) {
+        encode     = encodeBmi2;
+        encodeName = "bmi2";
+    }
+    #endif
+
+    if (cpu.sse42) {
+        crc32c     = crc32cSse42;
+        crc32cName = "sse4.2";
+    }
+#endif
+}
+
+}
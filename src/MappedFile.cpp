@@ -0,0 +1,110 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <MappedFile.hpp>
+#include <stdexcept>
+#include <fstream>
+#include <filesystem>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #define HFM_MMAP
+    #include <sys/mman.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+namespace hfm {
+
+MappedFile::MappedFile(const char* path)
+    : m_data(nullptr), m_size(std::filesystem::file_size(path)),
+      m_mapped(false) {
+    if (m_size == 0) {
+        return;
+    }
+
+#ifdef HFM_MMAP
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Unable to open file");
+    }
+
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data != MAP_FAILED) {
+        // The file is read front to back
+        madvise(data, m_size, MADV_SEQUENTIAL);
+        m_data   = static_cast<const char*>(data);
+        m_mapped = true;
+        return;
+    }
+#endif
+
+    char* buff = new char[m_size];
+    std::ifstream stream(path, std::ios::binary);
+    stream.read(buff, m_size);
+    if (static_cast<std::uint64_t>(stream.gcount()) != m_size) {
+        delete[] buff;
+        throw std::runtime_error("Unable to read file");
+    }
+    m_data = buff;
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : m_data(other.m_data), m_size(other.m_size), m_mapped(other.m_mapped) {
+    other.m_data   = nullptr;
+    other.m_size   = 0;
+    other.m_mapped = false;
+}
+
+MappedFile::~MappedFile() {
+    release();
+}
+
+const char* MappedFile::getData() const {
+    return m_data;
+}
+
+std::uint64_t MappedFile::getSize() const {
+    return m_size;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        release();
+        m_data   = other.m_data;
+        m_size   = other.m_size;
+        m_mapped = other.m_mapped;
+
+        other.m_data   = nullptr;
+        other.m_size   = 0;
+        other.m_mapped = false;
+    }
+
+    return *this;
+}
+
+void MappedFile::release() {
+#ifdef HFM_MMAP
+    if (m_mapped) {
+        munmap(const_cast<char*>(m_data), m_size);
+        m_data = nullptr;
+        return;
+    }
+#endif
+
+    delete[] m_data;
+    m_data = nullptr;
+}
+
+}
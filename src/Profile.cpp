@@ -0,0 +1,143 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <Profile.hpp>
+#include <BlockFormat.hpp>
+#include <BlockSplitter.hpp>
+#include <JobPool.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+constexpr unsigned int MAX_THREADS       = 1024;
+constexpr std::uint64_t MIN_SEGMENT_SIZE = 64 << 10;
+constexpr std::uint64_t MAX_SEGMENT_SIZE = std::uint64_t(1) << 30;
+
+std::uint64_t parseValue(const std::string& value, std::uint64_t min,
+                         std::uint64_t max, const std::string& path) {
+    std::size_t used    = 0;
+    std::uint64_t number = 0;
+    try {
+        number = std::stoull(value, &used);
+    } catch (const std::exception&) {
+        used = 0;
+    }
+
+    if (used == 0 || used != value.size() || number < min || number > max) {
+        throw std::runtime_error("Invalid value " + value + " in profile " +
+                                 path);
+    }
+
+    return number;
+}
+
+}
+
+namespace hfm {
+
+Profile::Profile()
+    : threads(std::max(std::thread::hardware_concurrency(), 1u)),
+      segmentSize(JobPool::SEGMENT_SIZE),
+      maxBlockSize(BlockFormat::MAX_BLOCK_SIZE) {}
+
+const Profile& Profile::get() {
+    static const Profile profile = []() {
+        const std::string path = getDefaultPath();
+        std::error_code error;
+        if (path.empty() || !std::filesystem::exists(path, error)) {
+            return Profile();
+        }
+
+        return load(path);
+    }();
+
+    return profile;
+}
+
+std::string Profile::getDefaultPath() {
+    const char* path = std::getenv("HFM_PROFILE");
+    if (path != nullptr) {
+        return path;
+    }
+
+    const char* home = std::getenv("HOME");
+    if (home == nullptr) {
+        home = std::getenv("USERPROFILE");
+    }
+
+    return home != nullptr
+               ? (std::filesystem::path(home) / ".huffman-profile").string()
+               : std::string();
+}
+
+Profile Profile::load(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        throw std::runtime_error("Unable to open profile " + path);
+    }
+
+    // Unknown keys are skipped, so older programs can read newer profiles
+    Profile profile;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        const std::size_t equals = line.find('=');
+        if (equals == std::string::npos) {
+            throw std::runtime_error("Invalid line " + line + " in profile " +
+                                     path);
+        }
+
+        const std::string key   = line.substr(0, equals);
+        const std::string value = line.substr(equals + 1);
+        if (key == "version") {
+            parseValue(value, 1, VERSION, path);
+        } else if (key == "threads") {
+            profile.threads = static_cast<unsigned int>(
+                parseValue(value, 1, MAX_THREADS, path));
+        } else if (key == "segment_size") {
+            profile.segmentSize =
+                parseValue(value, MIN_SEGMENT_SIZE, MAX_SEGMENT_SIZE, path);
+        } else if (key == "max_block_size") {
+            profile.maxBlockSize =
+                parseValue(value, BlockSplitter::SEGMENT_SIZE,
+                           BlockFormat::MAX_BLOCK_SIZE, path);
+        }
+    }
+
+    return profile;
+}
+
+void Profile::save(const std::string& path) const {
+    std::ofstream out(path);
+    out << "# Written by huffman --autotune\n";
+    out << "version=" << VERSION << "\n";
+    out << "threads=" << threads << "\n";
+    out << "segment_size=" << segmentSize << "\n";
+    out << "max_block_size=" << maxBlockSize << "\n";
+    out.close();
+
+    if (!out) {
+        throw std::runtime_error("Unable to write profile " + path);
+    }
+}
+
+}
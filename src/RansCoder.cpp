@@ -0,0 +1,176 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <RansCoder.hpp>
+#include <ByteOrder.hpp>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+constexpr int FREQ_SIZE          = 256;
+constexpr std::uint32_t SCALE    = 1u << hfm::RansCoder::SCALE_BITS;
+constexpr unsigned int WORD_BITS = 16;
+
+}
+
+namespace hfm {
+
+RansCoder::RansCoder()
+    : m_counts(), m_frequencies(), m_starts(), m_symbols(0) {}
+
+void RansCoder::setFrequencies(const std::uint64_t* frequencies) {
+    std::uint64_t total = 0;
+    for (int i = 0; i < FREQ_SIZE; i++) {
+        m_counts[i] = frequencies[i];
+        total += frequencies[i];
+    }
+
+    m_symbols = 0;
+    if (total == 0) {
+        for (int i = 0; i < FREQ_SIZE; i++) {
+            m_frequencies[i] = 0;
+            m_starts[i]      = 0;
+        }
+        return;
+    }
+
+    // Scale down, keeping at least 1 for every byte that occurs
+    std::uint32_t sum = 0;
+    int largest       = 0;
+    for (int i = 0; i < FREQ_SIZE; i++) {
+        std::uint32_t scaled = 0;
+        if (frequencies[i] != 0) {
+            scaled = static_cast<std::uint32_t>(
+                static_cast<double>(frequencies[i]) * SCALE / total);
+            scaled = scaled == 0 ? 1 : scaled;
+            m_symbols++;
+        }
+
+        m_frequencies[i] = scaled;
+        sum += scaled;
+        if (scaled > m_frequencies[largest]) {
+            largest = i;
+        }
+    }
+
+    // Rounding errors go to the bytes with the largest frequencies, which
+    // lose the least from them
+    while (sum != SCALE) {
+        if (sum < SCALE) {
+            m_frequencies[largest] += SCALE - sum;
+            sum = SCALE;
+            break;
+        }
+
+        int top = largest;
+        for (int i = 0; i < FREQ_SIZE; i++) {
+            if (m_frequencies[i] > m_frequencies[top]) {
+                top = i;
+            }
+        }
+
+        std::uint32_t take = sum - SCALE;
+        if (take > m_frequencies[top] / 2) {
+            take = m_frequencies[top] / 2;
+        }
+        m_frequencies[top] -= take;
+        sum -= take;
+    }
+
+    std::uint32_t start = 0;
+    for (int i = 0; i < FREQ_SIZE; i++) {
+        m_starts[i] = start;
+        start += m_frequencies[i];
+    }
+}
+
+std::uint64_t RansCoder::estimateSize() const {
+    double bits = 0;
+    for (int i = 0; i < FREQ_SIZE; i++) {
+        if (m_counts[i] != 0) {
+            bits += static_cast<double>(m_counts[i]) *
+                    (SCALE_BITS - std::log2(m_frequencies[i]));
+        }
+    }
+
+    return 2 + m_symbols * 3 + STREAMS * 4 +
+           static_cast<std::uint64_t>(bits / 8) + 1;
+}
+
+std::uint64_t RansCoder::compress(const char* inBuff, std::uint64_t size,
+                                  char* outBuff, std::uint64_t numBytes) const {
+    const std::uint64_t tableSize = 2 + m_symbols * 3;
+    if (numBytes < tableSize + STREAMS * 4) {
+        return 0;
+    }
+
+    // Table of the scaled frequencies
+    writeLE16(outBuff, static_cast<std::uint16_t>(m_symbols));
+    std::uint64_t written = 2;
+    for (int i = 0; i < FREQ_SIZE; i++) {
+        if (m_frequencies[i] != 0) {
+            outBuff[written] = static_cast<char>(i);
+            writeLE16(outBuff + written + 1,
+                      static_cast<std::uint16_t>(m_frequencies[i]));
+            written += 3;
+        }
+    }
+
+    // The coder works from the last byte to the first, so the stream is
+    // written backwards from the end of the buffer
+    char* end  = outBuff + numBytes;
+    char* out  = end;
+    char* stop = outBuff + tableSize + STREAMS * 4;
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(inBuff);
+
+    std::uint32_t states[STREAMS];
+    for (auto& state : states) {
+        state = STATE_LOW;
+    }
+
+    for (std::uint64_t i = size; i > 0; i--) {
+        unsigned char symbol    = in[i - 1];
+        std::uint32_t frequency = m_frequencies[symbol];
+        std::uint32_t& state    = states[(i - 1) % STREAMS];
+
+        // Move the low bits out if the state would leave its range
+        std::uint64_t limit = static_cast<std::uint64_t>(
+                                  (STATE_LOW >> SCALE_BITS) << WORD_BITS) *
+                              frequency;
+        if (state >= limit) {
+            if (out - stop < 2) {
+                return 0;
+            }
+
+            out -= 2;
+            writeLE16(out, static_cast<std::uint16_t>(state & 0xFFFF));
+            state >>= WORD_BITS;
+        }
+
+        state = ((state / frequency) << SCALE_BITS) + state % frequency +
+                m_starts[symbol];
+    }
+
+    for (int i = STREAMS; i > 0; i--) {
+        out -= 4;
+        writeLE32(out, states[i - 1]);
+    }
+
+    std::uint64_t streamSize = end - out;
+    std::memmove(outBuff + tableSize, out, streamSize);
+    return tableSize + streamSize;
+}
+
+}
@@ -0,0 +1,173 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <RansDecoder.hpp>
+#include <ByteOrder.hpp>
+#include <stdexcept>
+
+namespace {
+
+constexpr int FREQ_SIZE          = 256;
+constexpr unsigned int WORD_BITS = 16;
+constexpr int STREAMS            = hfm::RansCoder::STREAMS;
+constexpr std::uint32_t LOW      = hfm::RansCoder::STATE_LOW;
+constexpr std::uint32_t MASK     = (1u << hfm::RansCoder::SCALE_BITS) - 1;
+
+}
+
+namespace hfm {
+
+RansDecoder::RansDecoder()
+    : m_inBuff(nullptr), m_inBuffSize(0), m_table(), m_states(), m_read(0),
+      m_position(0) {}
+
+void RansDecoder::reset(const char* inBuff, std::uint64_t buffSize) {
+    m_inBuff     = inBuff;
+    m_inBuffSize = buffSize;
+    m_read       = 0;
+    m_position   = 0;
+    loadTableFromStream();
+}
+
+void RansDecoder::decompress(char* outBuff, std::uint64_t numBytes) {
+    const Entry* table = m_table;
+    std::uint64_t i    = 0;
+
+    // Every symbol reads at most one word, so while a word per symbol is
+    // left whole rounds of STREAMS symbols need no input checks
+    if (m_position % STREAMS == 0) {
+        std::uint64_t rounds = (m_inBuffSize - m_read) / (2 * STREAMS);
+        if (rounds > numBytes / STREAMS) {
+            rounds = numBytes / STREAMS;
+        }
+
+        const char* in = m_inBuff + m_read;
+        std::uint32_t s0 = m_states[0];
+        std::uint32_t s1 = m_states[1];
+        std::uint32_t s2 = m_states[2];
+        std::uint32_t s3 = m_states[3];
+        for (std::uint64_t r = 0; r < rounds; r++, i += STREAMS) {
+            const Entry& e0 = table[s0 & MASK];
+            const Entry& e1 = table[s1 & MASK];
+            const Entry& e2 = table[s2 & MASK];
+            const Entry& e3 = table[s3 & MASK];
+            outBuff[i]     = static_cast<char>(e0.symbol);
+            outBuff[i + 1] = static_cast<char>(e1.symbol);
+            outBuff[i + 2] = static_cast<char>(e2.symbol);
+            outBuff[i + 3] = static_cast<char>(e3.symbol);
+            s0 = e0.frequency * (s0 >> RansCoder::SCALE_BITS) + e0.bias;
+            s1 = e1.frequency * (s1 >> RansCoder::SCALE_BITS) + e1.bias;
+            s2 = e2.frequency * (s2 >> RansCoder::SCALE_BITS) + e2.bias;
+            s3 = e3.frequency * (s3 >> RansCoder::SCALE_BITS) + e3.bias;
+            if (s0 < LOW) {
+                s0 = (s0 << WORD_BITS) | readLE16(in);
+                in += 2;
+            }
+            if (s1 < LOW) {
+                s1 = (s1 << WORD_BITS) | readLE16(in);
+                in += 2;
+            }
+            if (s2 < LOW) {
+                s2 = (s2 << WORD_BITS) | readLE16(in);
+                in += 2;
+            }
+            if (s3 < LOW) {
+                s3 = (s3 << WORD_BITS) | readLE16(in);
+                in += 2;
+            }
+        }
+
+        m_states[0] = s0;
+        m_states[1] = s1;
+        m_states[2] = s2;
+        m_states[3] = s3;
+        m_read      = in - m_inBuff;
+        m_position += i;
+    }
+
+    // The rest is decoded one symbol at a time, checking every read
+    for (; i < numBytes; i++, m_position++) {
+        std::uint32_t& state = m_states[m_position % STREAMS];
+        const Entry& entry   = table[state & MASK];
+        outBuff[i]           = static_cast<char>(entry.symbol);
+        state = entry.frequency * (state >> RansCoder::SCALE_BITS) + entry.bias;
+        if (state < LOW) {
+            if (m_inBuffSize - m_read < 2) {
+                throw std::runtime_error("Truncated stream");
+            }
+
+            state = (state << WORD_BITS) | readLE16(m_inBuff + m_read);
+            m_read += 2;
+        }
+    }
+}
+
+void RansDecoder::finish() const {
+    // The coder started every state at STATE_LOW and used every word
+    for (const auto& state : m_states) {
+        if (state != LOW) {
+            throw std::runtime_error("Invalid rANS stream");
+        }
+    }
+
+    if (m_read != m_inBuffSize) {
+        throw std::runtime_error("Invalid rANS stream");
+    }
+}
+
+void RansDecoder::loadTableFromStream() {
+    if (m_inBuffSize < 2) {
+        throw std::runtime_error("Truncated stream header");
+    }
+
+    unsigned int symbols = readLE16(m_inBuff);
+    m_read               = 2;
+    if (symbols == 0 || symbols > FREQ_SIZE ||
+        m_inBuffSize - m_read < symbols * 3 + STREAMS * 4) {
+        throw std::runtime_error("Invalid rANS stream header");
+    }
+
+    std::uint32_t start = 0;
+    for (unsigned int i = 0; i < symbols; i++) {
+        const char* entry     = m_inBuff + m_read;
+        std::uint8_t symbol   = static_cast<std::uint8_t>(entry[0]);
+        std::uint32_t frequency = readLE16(entry + 1);
+        m_read += 3;
+
+        if (frequency == 0 || start + frequency > MASK + 1) {
+            throw std::runtime_error("Invalid rANS stream header");
+        }
+
+        for (std::uint32_t slot = start; slot < start + frequency; slot++) {
+            m_table[slot].frequency = static_cast<std::uint16_t>(frequency);
+            m_table[slot].bias      = static_cast<std::uint16_t>(slot - start);
+            m_table[slot].symbol    = symbol;
+        }
+        start += frequency;
+    }
+
+    if (start != MASK + 1) {
+        throw std::runtime_error("Invalid rANS stream header");
+    }
+
+    for (auto& state : m_states) {
+        state = readLE32(m_inBuff + m_read);
+        m_read += 4;
+        if (state < LOW) {
+            throw std::runtime_error("Invalid rANS stream header");
+        }
+    }
+}
+
+}
@@ -0,0 +1,271 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <Transform.hpp>
+#include <Kernels.hpp>
+#include <stdexcept>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+constexpr int FREQ_SIZE = 256;
+// choose() looks at up to SAMPLES pieces of SAMPLE_SIZE bytes
+constexpr std::uint64_t SAMPLE_SIZE = 4 << 10;
+constexpr std::uint64_t SAMPLES     = 8;
+// A transform costs a pass on both sides, so it has to save this much
+constexpr double MIN_GAIN = 0.97;
+// RLE: repeats after the first two bytes of a run that fit in one count
+constexpr unsigned int MAX_RUN = 255;
+
+class DeltaTransform : public hfm::Transform {
+public:
+    const char* getName() const override {
+        return "delta";
+    }
+
+    std::uint64_t getMaxOutput(std::uint64_t size) const override {
+        return size;
+    }
+
+    std::uint64_t forward(const char* inBuff, std::uint64_t size,
+                          char* outBuff) const override {
+        const unsigned char* in =
+            reinterpret_cast<const unsigned char*>(inBuff);
+        unsigned char previous = 0;
+        for (std::uint64_t i = 0; i < size; i++) {
+            outBuff[i] = static_cast<char>(in[i] - previous);
+            previous   = in[i];
+        }
+
+        return size;
+    }
+
+    void inverse(const char* inBuff, std::uint64_t size, char* outBuff,
+                 std::uint64_t numBytes) const override {
+        if (size != numBytes) {
+            throw std::runtime_error("Invalid transformed data");
+        }
+
+        const unsigned char* in =
+            reinterpret_cast<const unsigned char*>(inBuff);
+        unsigned char value = 0;
+        for (std::uint64_t i = 0; i < size; i++) {
+            value      = static_cast<unsigned char>(value + in[i]);
+            outBuff[i] = static_cast<char>(value);
+        }
+    }
+};
+
+class RleTransform : public hfm::Transform {
+public:
+    const char* getName() const override {
+        return "rle";
+    }
+
+    // Every pair of equal bytes can gain a count byte
+    std::uint64_t getMaxOutput(std::uint64_t size) const override {
+        return size + size / 2 + 1;
+    }
+
+    std::uint64_t forward(const char* inBuff, std::uint64_t size,
+                          char* outBuff) const override {
+        std::uint64_t written = 0;
+        std::uint64_t i       = 0;
+        while (i < size) {
+            const char byte    = inBuff[i];
+            outBuff[written++] = byte;
+            if (i + 1 == size || inBuff[i + 1] != byte) {
+                i++;
+                continue;
+            }
+
+            // Two equal bytes are followed by the number of further repeats
+            outBuff[written++] = byte;
+            i += 2;
+            unsigned int run = 0;
+            while (i < size && inBuff[i] == byte && run < MAX_RUN) {
+                run++;
+                i++;
+            }
+            outBuff[written++] = static_cast<char>(run);
+        }
+
+        return written;
+    }
+
+    void inverse(const char* inBuff, std::uint64_t size, char* outBuff,
+                 std::uint64_t numBytes) const override {
+        std::uint64_t read    = 0;
+        std::uint64_t written = 0;
+        while (read < size && written < numBytes) {
+            const char byte    = inBuff[read++];
+            outBuff[written++] = byte;
+            if (read == size || written == numBytes || inBuff[read] != byte) {
+                continue;
+            }
+
+            outBuff[written++] = byte;
+            read++;
+            if (read == size) {
+                throw std::runtime_error("Invalid transformed data");
+            }
+
+            unsigned int run = static_cast<unsigned char>(inBuff[read++]);
+            if (run > numBytes - written) {
+                throw std::runtime_error("Invalid transformed data");
+            }
+            std::memset(outBuff + written, byte, run);
+            written += run;
+        }
+
+        if (read != size || written != numBytes) {
+            throw std::runtime_error("Invalid transformed data");
+        }
+    }
+};
+
+class MtfTransform : public hfm::Transform {
+public:
+    const char* getName() const override {
+        return "mtf";
+    }
+
+    std::uint64_t getMaxOutput(std::uint64_t size) const override {
+        return size;
+    }
+
+    std::uint64_t forward(const char* inBuff, std::uint64_t size,
+                          char* outBuff) const override {
+        unsigned char order[FREQ_SIZE];
+        std::iota(order, order + FREQ_SIZE, 0);
+
+        const unsigned char* in =
+            reinterpret_cast<const unsigned char*>(inBuff);
+        for (std::uint64_t i = 0; i < size; i++) {
+            const unsigned char byte = in[i];
+            unsigned int index       = 0;
+            while (order[index] != byte) {
+                index++;
+            }
+
+            std::memmove(order + 1, order, index);
+            order[0]   = byte;
+            outBuff[i] = static_cast<char>(index);
+        }
+
+        return size;
+    }
+
+    void inverse(const char* inBuff, std::uint64_t size, char* outBuff,
+                 std::uint64_t numBytes) const override {
+        if (size != numBytes) {
+            throw std::runtime_error("Invalid transformed data");
+        }
+
+        unsigned char order[FREQ_SIZE];
+        std::iota(order, order + FREQ_SIZE, 0);
+
+        const unsigned char* in =
+            reinterpret_cast<const unsigned char*>(inBuff);
+        for (std::uint64_t i = 0; i < size; i++) {
+            const unsigned int index = in[i];
+            const unsigned char byte = order[index];
+            std::memmove(order + 1, order, index);
+            order[0]   = byte;
+            outBuff[i] = static_cast<char>(byte);
+        }
+    }
+};
+
+// Order-0 entropy of the counts in bits
+double getEntropy(const std::uint64_t* counts) {
+    double total = 0;
+    for (int i = 0; i < FREQ_SIZE; i++) {
+        total += static_cast<double>(counts[i]);
+    }
+
+    double bits = 0;
+    for (int i = 0; i < FREQ_SIZE; i++) {
+        if (counts[i] != 0) {
+            const double count = static_cast<double>(counts[i]);
+            bits -= count * std::log2(count / total);
+        }
+    }
+
+    return bits;
+}
+
+}
+
+namespace hfm {
+
+const Transform* Transform::get(Type type) {
+    static const DeltaTransform delta;
+    static const RleTransform rle;
+    static const MtfTransform mtf;
+
+    switch (type) {
+    case DELTA:
+        return &delta;
+    case RLE:
+        return &rle;
+    case MTF:
+        return &mtf;
+    default:
+        return nullptr;
+    }
+}
+
+Transform::Type Transform::choose(const char* data, std::uint64_t size) {
+    if (size < SAMPLE_SIZE) {
+        return NONE; // Too small to pay for the extra passes
+    }
+
+    // Samples spread evenly over the data, each transformed on its own
+    const std::uint64_t samples = std::min(SAMPLES, size / SAMPLE_SIZE);
+    const std::uint64_t stride  = size / samples;
+
+    std::uint64_t counts[TYPES][FREQ_SIZE] = {};
+    char scratch[SAMPLE_SIZE + SAMPLE_SIZE / 2 + 1];
+    const Kernels& kernels = Kernels::get();
+    for (std::uint64_t i = 0; i < samples; i++) {
+        const char* sample = data + i * stride;
+        kernels.histogram(reinterpret_cast<const unsigned char*>(sample),
+                          SAMPLE_SIZE, counts[NONE]);
+
+        for (int type = NONE + 1; type < TYPES; type++) {
+            std::uint64_t written = get(static_cast<Type>(type))
+                                        ->forward(sample, SAMPLE_SIZE, scratch);
+            kernels.histogram(reinterpret_cast<const unsigned char*>(scratch),
+                              written, counts[type]);
+        }
+    }
+
+    Type best       = NONE;
+    double bestBits = getEntropy(counts[NONE]) * MIN_GAIN;
+    for (int type = NONE + 1; type < TYPES; type++) {
+        double bits = getEntropy(counts[type]);
+        if (bits < bestBits) {
+            best     = static_cast<Type>(type);
+            bestBits = bits;
+        }
+    }
+
+    return best;
+}
+
+}
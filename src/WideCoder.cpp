@@ -0,0 +1,144 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <WideCoder.hpp>
+#include <ByteOrder.hpp>
+#include <stdexcept>
+
+namespace {
+
+constexpr unsigned int WORD_BITS = 32;
+constexpr unsigned int BYTE_BITS = 8;
+
+}
+
+namespace hfm {
+
+WideCoder::WideCoder(const char* inBuff, std::uint64_t buffSize)
+    : m_frequencies(SYMBOLS), m_codes(SYMBOLS), m_symbolCount(0),
+      m_builder(SYMBOLS) {
+    reset(inBuff, buffSize);
+}
+
+void WideCoder::reset(const char* inBuff, std::uint64_t buffSize) {
+    m_inBuff        = reinterpret_cast<const unsigned char*>(inBuff);
+    m_inEnd         = m_inBuff + buffSize;
+    m_buffSize      = buffSize;
+    m_headerWritten = false;
+    m_finished      = false;
+    m_acc           = 0;
+    m_accUsed       = 0;
+}
+
+std::int64_t WideCoder::compress(char* outBuff, std::uint64_t numBytes) {
+    if (m_finished) {
+        return -1; // Signal end of buffer
+    }
+
+    std::uint64_t bytesWrote = 0;
+    if (!m_headerWritten) {
+        generateCodes();
+        if (numBytes < 8 + 4 + m_symbolCount * 3) {
+            throw std::length_error("Output buffer too small for header");
+        }
+
+        bytesWrote      = writeStreamHeader(outBuff);
+        m_headerWritten = true;
+    }
+
+    // A pair adds at most MAX_BITS, so a word can be flushed after every
+    // pair as long as 8 bytes are left
+    while (m_inBuff < m_inEnd && bytesWrote + 8 <= numBytes) {
+        unsigned int symbol = m_inBuff[0] << 8;
+        if (m_inBuff + 1 < m_inEnd) {
+            symbol |= m_inBuff[1];
+        }
+        m_inBuff = m_inEnd - m_inBuff >= 2 ? m_inBuff + 2 : m_inEnd;
+
+        const Code& code = m_codes[symbol];
+        m_acc            = (m_acc << code.length) | code.bits;
+        m_accUsed += code.length;
+
+        if (m_accUsed >= WORD_BITS) {
+            m_accUsed -= WORD_BITS;
+            std::uint32_t word =
+                static_cast<std::uint32_t>(m_acc >> m_accUsed);
+            for (unsigned int i = 1; i <= 4; i++) {
+                outBuff[bytesWrote++] = static_cast<char>(
+                    (word >> (WORD_BITS - i * BYTE_BITS)) & 0xFF);
+            }
+        }
+    }
+
+    // Write the last bits, padded with zeros to a whole byte
+    if (m_inBuff == m_inEnd && bytesWrote + 4 <= numBytes) {
+        while (m_accUsed > 0) {
+            unsigned int take = m_accUsed >= BYTE_BITS ? BYTE_BITS : m_accUsed;
+            m_accUsed -= take;
+            outBuff[bytesWrote++] = static_cast<char>(
+                ((m_acc >> m_accUsed) << (BYTE_BITS - take)) & 0xFF);
+        }
+        m_finished = true;
+    }
+
+    if (bytesWrote == 0 && !m_finished) {
+        throw std::length_error("Output buffer too small");
+    }
+
+    return bytesWrote;
+}
+
+void WideCoder::generateCodes() {
+    for (auto& f : m_frequencies) {
+        f = 0;
+    }
+
+    const unsigned char* p = m_inBuff;
+    for (; p + 1 < m_inEnd; p += 2) {
+        m_frequencies[(p[0] << 8) | p[1]]++;
+    }
+    if (p < m_inEnd) {
+        m_frequencies[p[0] << 8]++;
+    }
+
+    m_builder.build(m_frequencies.data(), m_codes.data(), MAX_BITS);
+
+    m_symbolCount = 0;
+    for (const auto& code : m_codes) {
+        m_symbolCount += code.length != 0 ? 1 : 0;
+    }
+}
+
+std::uint64_t WideCoder::writeStreamHeader(char* outBuff) {
+    std::uint64_t written = 0;
+    writeLE64(outBuff, m_buffSize);
+    written += sizeof(std::uint64_t);
+    writeLE32(outBuff + written, m_symbolCount);
+    written += sizeof(std::uint32_t);
+
+    // Lengths are enough, the decoder rebuilds the same canonical codes
+    for (int i = 0; i < SYMBOLS; i++) {
+        if (m_codes[i].length == 0) {
+            continue;
+        }
+
+        writeLE16(outBuff + written, static_cast<std::uint16_t>(i));
+        outBuff[written + 2] = static_cast<char>(m_codes[i].length);
+        written += 3;
+    }
+
+    return written;
+}
+
+}
@@ -0,0 +1,225 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <WideDecoder.hpp>
+#include <WideCoder.hpp>
+#include <CodeBuilder.hpp>
+#include <ByteOrder.hpp>
+#include <stdexcept>
+
+namespace {
+
+constexpr unsigned int BITS      = 64;
+constexpr unsigned int BYTE_BITS = 8;
+constexpr unsigned int MAX_BITS  = hfm::WideCoder::MAX_BITS;
+constexpr int SYMBOLS            = hfm::WideCoder::SYMBOLS;
+constexpr int SYMBOL_BITS        = 16;
+
+}
+
+namespace hfm {
+
+WideDecoder::WideDecoder(const char* inBuff, std::uint64_t buffSize)
+    : m_codes(SYMBOLS), m_table(1 << TABLE_BITS), m_firstCode(MAX_BITS + 1),
+      m_lengthCounts(MAX_BITS + 1), m_offsets(MAX_BITS + 1),
+      m_sorted(SYMBOLS) {
+    reset(inBuff, buffSize);
+}
+
+void WideDecoder::reset(const char* inBuff, std::uint64_t buffSize) {
+    m_inBuff       = inBuff;
+    m_inBuffSize   = buffSize;
+    m_headerRead   = false;
+    m_originalSize = 0;
+    m_processed    = 0;
+    m_read         = 0;
+    m_acc          = 0;
+    m_accBits      = 0;
+}
+
+std::int64_t WideDecoder::decompress(char* outBuff, std::uint64_t numBytes) {
+    if (!m_headerRead) {
+        loadDictionaryFromStream();
+        generateTables();
+        m_headerRead = true;
+    }
+
+    if (m_processed >= m_originalSize) {
+        return -1; // Signal end of buffer
+    }
+
+    if (numBytes < 2) {
+        throw std::length_error("Output buffer too small");
+    }
+
+    std::uint64_t bytesWrote = 0;
+    while (bytesWrote + 2 <= numBytes && m_processed < m_originalSize) {
+        unsigned int symbol = decodeSymbol();
+
+        outBuff[bytesWrote++] = static_cast<char>(symbol >> 8);
+        m_processed++;
+        // The zero byte after an odd last byte is not part of the data
+        if (m_processed < m_originalSize) {
+            outBuff[bytesWrote++] = static_cast<char>(symbol & 0xFF);
+            m_processed++;
+        }
+    }
+
+    return bytesWrote;
+}
+
+void WideDecoder::loadDictionaryFromStream() {
+    if (m_inBuffSize < 12) {
+        throw std::runtime_error("Truncated stream header");
+    }
+
+    m_originalSize            = readLE64(m_inBuff);
+    std::uint32_t symbolCount = readLE32(m_inBuff + 8);
+    m_read                    = 12;
+
+    if (symbolCount > SYMBOLS || m_inBuffSize - m_read < symbolCount * 3ULL) {
+        throw std::runtime_error("Truncated stream header");
+    }
+
+    for (auto& code : m_codes) {
+        code.length = 0;
+    }
+
+    // Codes must not claim more than the whole code space
+    std::uint64_t kraft = 0;
+    for (std::uint32_t i = 0; i < symbolCount; i++) {
+        std::uint16_t symbol = readLE16(m_inBuff + m_read);
+        unsigned int length  = static_cast<unsigned char>(m_inBuff[m_read + 2]);
+        m_read += 3;
+
+        if (length == 0 || length > MAX_BITS) {
+            throw std::runtime_error("Invalid code size in stream header");
+        }
+
+        m_codes[symbol].length = length;
+        kraft += std::uint64_t(1) << (MAX_BITS - length);
+    }
+
+    if (kraft > (std::uint64_t(1) << MAX_BITS)) {
+        throw std::runtime_error("Codes are not prefix free");
+    }
+
+    CodeBuilder::assignCanonicalCodes(m_codes.data(), SYMBOLS);
+}
+
+void WideDecoder::generateTables() {
+    for (auto& entry : m_table) {
+        entry = 0;
+    }
+    for (unsigned int i = 0; i <= MAX_BITS; i++) {
+        m_firstCode[i]    = 0;
+        m_lengthCounts[i] = 0;
+    }
+
+    for (int i = 0; i < SYMBOLS; i++) {
+        const Code& code = m_codes[i];
+        if (code.length == 0) {
+            continue;
+        }
+
+        m_lengthCounts[code.length]++;
+
+        // A short code fills every table entry it is a prefix of
+        if (code.length <= TABLE_BITS) {
+            std::uint32_t first = code.bits << (TABLE_BITS - code.length);
+            std::uint32_t count = 1 << (TABLE_BITS - code.length);
+            for (std::uint32_t j = 0; j < count; j++) {
+                m_table[first + j] = i | (code.length << SYMBOL_BITS);
+            }
+        }
+    }
+
+    unsigned int offset = 0;
+    for (unsigned int length = 1; length <= MAX_BITS; length++) {
+        m_offsets[length] = offset;
+        offset += m_lengthCounts[length];
+    }
+
+    // Canonical codes of one length are consecutive in symbol order
+    std::uint32_t counts[MAX_BITS + 1] = {};
+    for (int i = 0; i < SYMBOLS; i++) {
+        unsigned int length = m_codes[i].length;
+        if (length == 0) {
+            continue;
+        }
+
+        if (counts[length] == 0) {
+            m_firstCode[length] = static_cast<std::uint32_t>(m_codes[i].bits);
+        }
+        m_sorted[m_offsets[length] + counts[length]++] =
+            static_cast<std::uint16_t>(i);
+    }
+}
+
+void WideDecoder::refill() {
+    // Load whole words while they fit in the input
+    if (m_read + 8 <= m_inBuffSize) {
+        std::uint64_t word = Kernels::get().refill(m_inBuff + m_read);
+        m_acc |= word >> m_accBits;
+        unsigned int bytes = (BITS - 1 - m_accBits) / BYTE_BITS;
+        m_read += bytes;
+        m_accBits += bytes * BYTE_BITS;
+        return;
+    }
+
+    while (m_accBits <= BITS - BYTE_BITS && m_read < m_inBuffSize) {
+        std::uint64_t byte = static_cast<unsigned char>(m_inBuff[m_read++]);
+        m_acc |= byte << (BITS - BYTE_BITS - m_accBits);
+        m_accBits += BYTE_BITS;
+    }
+}
+
+unsigned int WideDecoder::decodeSymbol() {
+    if (m_accBits < MAX_BITS) {
+        refill();
+    }
+
+    unsigned int length = 0;
+    unsigned int symbol = 0;
+    std::uint32_t entry = m_table[m_acc >> (BITS - TABLE_BITS)];
+
+    if (entry != 0) {
+        length = entry >> SYMBOL_BITS;
+        symbol = entry & 0xFFFF;
+    } else {
+        for (length = TABLE_BITS + 1; length <= MAX_BITS; length++) {
+            std::uint32_t code =
+                static_cast<std::uint32_t>(m_acc >> (BITS - length));
+            std::uint32_t index = code - m_firstCode[length];
+            if (code >= m_firstCode[length] && index < m_lengthCounts[length]) {
+                symbol = m_sorted[m_offsets[length] + index];
+                break;
+            }
+        }
+
+        if (length > MAX_BITS) {
+            throw std::runtime_error("Invalid code in stream");
+        }
+    }
+
+    if (length > m_accBits) {
+        throw std::runtime_error("Truncated stream");
+    }
+
+    m_acc <<= length;
+    m_accBits -= length;
+    return symbol;
+}
+
+}
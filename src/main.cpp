@@ -15,16 +15,73 @@
 #include <Version.hpp>
 #include <HuffmanCoder.hpp>
 #include <HuffmanDecoder.hpp>
+#include <AdaptiveCoder.hpp>
+#include <AdaptiveDecoder.hpp>
+#include <WideCoder.hpp>
+#include <WideDecoder.hpp>
+#include <BlockCoder.hpp>
+#include <BlockDecoder.hpp>
+#include <FrameCoder.hpp>
+#include <FrameDecoder.hpp>
+#include <MappedFile.hpp>
+#include <ArchiveWriter.hpp>
+#include <ArchiveReader.hpp>
+#include <Histogram.hpp>
+#include <JobPool.hpp>
+#include <Profile.hpp>
+#include <Autotuner.hpp>
+#include <Kernels.hpp>
+#include <IoBackend.hpp>
+#include <AsyncReader.hpp>
+#include <AsyncWriter.hpp>
 #include <iostream>
+#include <algorithm>
 #include <cstring>
-#include <fstream>
 #include <filesystem>
+#include <cstdint>
+#include <stdexcept>
+#include <memory>
+#include <vector>
+#include <string>
+
+namespace {
+
+// Large enough for the stream header and a good batch of codes
+constexpr std::uint64_t OUT_BUFF_SIZE = 1 << 17;
+
+}
 
 void printHelp() {
     std::cout << "Program usage: huffman [flags] input_file output_file\n";
+    std::cout << "               huffman -t input_file\n";
+    std::cout << "               huffman -a|-as archive files...\n";
+    std::cout << "               huffman -x archive [directory [member]]\n";
+    std::cout << "               huffman -l archive\n";
+    std::cout << "               huffman -q|-qm histogram files...\n";
+    std::cout << "               huffman -at histogram archive files...\n";
+    std::cout << "               huffman -am archive archives...\n";
+    std::cout << "               huffman --autotune input_file [profile]\n";
     std::cout << "Currently supported flags:\n";
     std::cout << "\t-c Compress contents of input_file into output_file\n";
     std::cout << "\t-d Decompress contents of output_file into input_file\n";
+    std::cout << "\t-ac Compress in one pass with adaptive codes\n";
+    std::cout << "\t-ad Decompress a file compressed with -ac\n";
+    std::cout << "\t-wc Compress with 16 bit symbols (byte pairs)\n";
+    std::cout << "\t-wd Decompress a file compressed with -wc\n";
+    std::cout << "\t-bc Compress in blocks with their own code tables\n";
+    std::cout << "\t-bd Decompress a file compressed with -bc\n";
+    std::cout << "\t-fc Compress a small message into one compact frame\n";
+    std::cout << "\t-fd Decompress one or more frames written by -fc\n";
+    std::cout << "\t-t Test input_file by decoding it without output\n";
+    std::cout << "\t-a Create an archive of files\n";
+    std::cout << "\t-as Create an archive with one table for all files\n";
+    std::cout << "\t-x Extract all members, or one, of an archive\n";
+    std::cout << "\t-l List the members of an archive\n";
+    std::cout << "\t-q Count the bytes of files into a histogram\n";
+    std::cout << "\t-qm Merge histograms written by -q\n";
+    std::cout << "\t-at Create an archive with the table of a histogram\n";
+    std::cout << "\t-am Merge archives without coding their members again\n";
+    std::cout << "\t--autotune Measure settings for this machine on a sample\n";
     std::cout << "\t-h Display this help message\n";
     std::cout << "\t-i Show info about the program" << std::endl;
 }
@@ -34,10 +91,506 @@ void printInfo() {
     std::cout << "\tAuthor: Dan Sirbu (@darwin-s)\n";
     std::cout << "\tCreation date: 11 May 2021\n";
     std::cout << "\tVersion: " << HFM_VER_MAJOR << "." << HFM_VER_MINOR <<
-                 "." << HFM_VER_PATCH << "." << HFM_VER_TWEAK << std::endl;
+                 "." << HFM_VER_PATCH << "." << HFM_VER_TWEAK << "\n";
+    std::cout << "\tKernels: histogram=" << hfm::Kernels::get().histogramName <<
+                 " encode=" << hfm::Kernels::get().encodeName <<
+                 " refill=" << hfm::Kernels::get().refillName <<
+                 " crc32c=" << hfm::Kernels::get().crc32cName << "\n";
+    std::unique_ptr<hfm::IoBackend> backend = hfm::IoBackend::create(1);
+    std::cout << "\tI/O: " << (backend ? backend->getName() : "streams") <<
+                 "\n";
+    const hfm::Profile& profile = hfm::Profile::get();
+    std::cout << "\tProfile: threads=" << profile.threads <<
+                 " segment_size=" << profile.segmentSize <<
+                 " max_block_size=" << profile.maxBlockSize << std::endl;
 }
 
-int main(int argc, char** argv) {
+void readAll(hfm::AsyncReader& reader, char* buff, std::uint64_t size) {
+    const char* part    = nullptr;
+    std::uint64_t read  = 0;
+    std::uint64_t count = 0;
+    while ((count = reader.next(part)) > 0 && read + count <= size) {
+        std::memcpy(buff + read, part, count);
+        read += count;
+    }
+}
+
+// The coders need the whole input, but reading it in parts keeps several
+// reads in flight
+std::vector<char> readFile(const char* path) {
+    hfm::AsyncReader reader(path);
+    std::vector<char> data(reader.getSize());
+    readAll(reader, data.data(), data.size());
+
+    return data;
+}
+
+// Runs one job on a pool with the threads and sizes of the profile
+int runJob(hfm::JobPool::Operation operation, const char* inPath,
+           const char* outPath) {
+    const hfm::Profile& profile = hfm::Profile::get();
+    hfm::JobPool pool(profile.threads, 1);
+    pool.setSegmentSize(profile.segmentSize);
+    pool.setMaxBlockSize(profile.maxBlockSize);
+
+    std::vector<char> input = readFile(inPath);
+    const std::uint64_t inputSize = input.size();
+    std::vector<char> output;
+    try {
+        output = pool.submit(operation, std::move(input)).get();
+    } catch (const std::runtime_error& e) {
+        // Damaged input is reported instead of aborting
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+
+    hfm::AsyncWriter out(outPath, std::max(inputSize, output.size()));
+    out.write(output.data(), output.size());
+    out.finish();
+    return 0;
+}
+
+int wideCompress(const char* inPath, const char* outPath) {
+    const std::vector<char> buff = readFile(inPath);
+
+    hfm::AsyncWriter out(outPath, buff.size());
+
+    hfm::WideCoder coder(buff.data(), buff.size());
+    std::vector<char> outBuff(hfm::WideCoder::MAX_HEADER_SIZE + OUT_BUFF_SIZE);
+    std::int64_t written = coder.compress(outBuff.data(), outBuff.size());
+
+    while (written >= 0) {
+        out.write(outBuff.data(), written);
+
+        written = coder.compress(outBuff.data(), outBuff.size());
+    }
+    out.finish();
+
+    return 0;
+}
+
+int wideDecompress(const char* inPath, const char* outPath) {
+    const std::vector<char> buff = readFile(inPath);
+
+    hfm::AsyncWriter out(outPath, buff.size());
+
+    std::vector<char> outBuff(OUT_BUFF_SIZE);
+    int result = 0;
+
+    try {
+        hfm::WideDecoder decoder(buff.data(), buff.size());
+        std::int64_t written =
+            decoder.decompress(outBuff.data(), OUT_BUFF_SIZE);
+
+        while (written >= 0) {
+            out.write(outBuff.data(), written);
+
+            written = decoder.decompress(outBuff.data(), OUT_BUFF_SIZE);
+        }
+        out.finish();
+    } catch (const std::runtime_error& e) {
+        // Damaged input is reported instead of aborting
+        std::cerr << e.what() << std::endl;
+        result = -1;
+    }
+
+    return result;
+}
+
+int blockCompress(const char* inPath, const char* outPath) {
+    // Large inputs are coded in segments on all threads
+    if (hfm::Profile::get().threads > 1) {
+        return runJob(hfm::JobPool::COMPRESS, inPath, outPath);
+    }
+
+    const std::vector<char> buff = readFile(inPath);
+
+    hfm::AsyncWriter out(outPath, buff.size());
+
+    hfm::BlockCoder coder(buff.data(), buff.size());
+    coder.setMaxBlockSize(hfm::Profile::get().maxBlockSize);
+    std::vector<char> outBuff(hfm::BlockCoder::MAX_OUTPUT);
+    std::int64_t written = coder.compress(outBuff.data(), outBuff.size());
+
+    while (written >= 0) {
+        out.write(outBuff.data(), written);
+
+        written = coder.compress(outBuff.data(), outBuff.size());
+    }
+    out.finish();
+
+    return 0;
+}
+
+int blockDecompress(const char* inPath, const char* outPath) {
+    if (hfm::Profile::get().threads > 1) {
+        return runJob(hfm::JobPool::DECOMPRESS, inPath, outPath);
+    }
+
+    const std::vector<char> buff = readFile(inPath);
+
+    hfm::AsyncWriter out(outPath, buff.size());
+
+    hfm::BlockDecoder decoder(buff.data(), buff.size());
+    std::vector<char> outBuff(hfm::BlockFormat::MAX_BLOCK_SIZE);
+    int result = 0;
+
+    try {
+        std::int64_t written =
+            decoder.decompress(outBuff.data(), outBuff.size());
+
+        while (written >= 0) {
+            out.write(outBuff.data(), written);
+
+            written = decoder.decompress(outBuff.data(), outBuff.size());
+        }
+        out.finish();
+    } catch (const std::runtime_error& e) {
+        // Damaged input is reported instead of aborting
+        std::cerr << e.what() << std::endl;
+        result = -1;
+    }
+
+    return result;
+}
+
+int frameCompress(const char* inPath, const char* outPath) {
+    const std::vector<char> buff = readFile(inPath);
+
+    hfm::AsyncWriter out(outPath, buff.size());
+
+    hfm::FrameCoder coder;
+    std::vector<char> outBuff(hfm::FrameCoder::getMaxOutput(buff.size()));
+    out.write(outBuff.data(),
+              coder.compress(buff.data(), buff.size(), outBuff.data()));
+    out.finish();
+
+    return 0;
+}
+
+int frameDecompress(const char* inPath, const char* outPath) {
+    const std::vector<char> buff = readFile(inPath);
+    const std::uint64_t buffSize = buff.size();
+
+    hfm::AsyncWriter out(outPath, buffSize);
+
+    hfm::FrameDecoder decoder;
+    std::vector<char> outBuff;
+    int result = 0;
+
+    // Frames written back to back are decoded one after another
+    try {
+        for (std::uint64_t read = 0; read < buffSize;) {
+            outBuff.resize(hfm::FrameDecoder::getOriginalSize(
+                buff.data() + read, buffSize - read));
+            read += decoder.decompress(buff.data() + read, buffSize - read,
+                                       outBuff.data());
+            out.write(outBuff.data(), outBuff.size());
+        }
+        out.finish();
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        result = -1;
+    }
+
+    return result;
+}
+
+int verify(const char* inPath) {
+    try {
+        hfm::MappedFile file(inPath);
+        std::uint64_t size = 0;
+
+        if (hfm::BlockFormat::isContainer(file.getData(), file.getSize())) {
+            hfm::BlockDecoder decoder(file.getData(), file.getSize());
+            size = decoder.verify(hfm::Profile::get().threads);
+        } else if (hfm::ArchiveFormat::isArchive(file.getData(),
+                                                 file.getSize())) {
+            hfm::ArchiveReader reader(file.getData(), file.getSize());
+            size = reader.verify(hfm::Profile::get().threads);
+        } else {
+            // Anything else is taken for a -c stream, which has no magic and
+            // no checksum, but its size and codes are still checked while
+            // decoding
+            hfm::HuffmanDecoder decoder(file.getData(), file.getSize());
+            std::vector<char> sink(OUT_BUFF_SIZE);
+            std::int64_t written = 0;
+            try {
+                while ((written = decoder.decompress(sink.data(),
+                                                     sink.size())) >= 0) {
+                    size += written;
+                }
+            } catch (const std::runtime_error& e) {
+                throw std::runtime_error(
+                    std::string("Unknown format or damaged -c stream: ") +
+                    e.what());
+            }
+            size += decoder.getLastBytes();
+        }
+
+        std::cout << inPath << ": OK (" << size << " bytes)" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << inPath << ": " << e.what() << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
+
+// Name a file is stored under: its relative path, or only its file name
+// when the path leads outside the current directory
+std::string getMemberName(const char* path) {
+    std::filesystem::path normal =
+        std::filesystem::path(path).lexically_normal().relative_path();
+
+    for (const auto& part : normal) {
+        if (part == "..") {
+            return normal.filename().generic_string();
+        }
+    }
+
+    return normal.generic_string();
+}
+
+// Byte counts of files, or with merge the sum of histograms written by -q,
+// for coding shards apart with one shared table
+int histogramCreate(const char* outPath, char** files, int count,
+                    bool merge) {
+    try {
+        hfm::Histogram histogram;
+        for (int i = 0; i < count; i++) {
+            hfm::MappedFile file(files[i]);
+            if (merge) {
+                histogram.merge(hfm::Histogram::deserialize(file.getData(),
+                                                            file.getSize()));
+            } else {
+                histogram.add(file.getData(), file.getSize());
+            }
+        }
+
+        char buff[hfm::Histogram::MAX_SERIALIZED_SIZE];
+        hfm::AsyncWriter out(outPath);
+        out.write(buff, histogram.serialize(buff));
+        out.finish();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
+
+// With a histogram file, every member is coded with its shared table, so
+// archives made from other shards with the same file can be merged by -am
+int archiveCreate(const char* archivePath, char** files, int count,
+                  bool shared, const char* tablePath) {
+    try {
+        std::vector<std::unique_ptr<hfm::MappedFile>> inputs;
+        std::uint64_t total = 0;
+        for (int i = 0; i < count; i++) {
+            inputs.push_back(std::make_unique<hfm::MappedFile>(files[i]));
+            total += inputs[i]->getSize();
+        }
+
+        hfm::AsyncWriter out(archivePath, total);
+        hfm::ArchiveWriter writer(out);
+
+        if (tablePath != nullptr) {
+            hfm::MappedFile table(tablePath);
+            writer.setSharedTable(
+                hfm::Histogram::deserialize(table.getData(), table.getSize()),
+                UINT64_MAX);
+        } else if (shared) {
+            // One table built from the bytes of the small files together
+            hfm::Histogram histogram;
+            for (const auto& input : inputs) {
+                if (input->getSize() <= hfm::ArchiveWriter::SHARED_MAX_MEMBER) {
+                    histogram.add(input->getData(), input->getSize());
+                }
+            }
+            writer.setSharedTable(histogram);
+        }
+
+        for (int i = 0; i < count; i++) {
+            writer.addMember(getMemberName(files[i]), inputs[i]->getData(),
+                             inputs[i]->getSize());
+        }
+        writer.finish();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
+
+// Puts the members of archives into one without decoding them. Members
+// coded with a shared table need the same table in every archive.
+int archiveMerge(const char* archivePath, char** parts, int count) {
+    try {
+        std::vector<std::unique_ptr<hfm::MappedFile>> inputs;
+        std::vector<hfm::ArchiveReader> readers;
+        std::uint64_t total = 0;
+        for (int i = 0; i < count; i++) {
+            inputs.push_back(std::make_unique<hfm::MappedFile>(parts[i]));
+            readers.emplace_back(inputs[i]->getData(), inputs[i]->getSize());
+            total += inputs[i]->getSize();
+        }
+
+        hfm::AsyncWriter out(archivePath, total);
+        hfm::ArchiveWriter writer(out);
+        for (const auto& reader : readers) {
+            if (reader.getSharedCodes() != nullptr) {
+                writer.setSharedCodes(reader.getSharedCodes());
+                break;
+            }
+        }
+
+        for (const auto& reader : readers) {
+            for (const auto& member : reader.getMembers()) {
+                writer.copyMember(reader, member);
+            }
+        }
+        writer.finish();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
+
+int archiveExtract(const char* archivePath, const char* directory,
+                   const char* memberName) {
+    try {
+        hfm::MappedFile file(archivePath);
+        hfm::ArchiveReader reader(file.getData(), file.getSize());
+
+        if (memberName == nullptr) {
+            reader.extractAll(directory, hfm::Profile::get().threads);
+            return 0;
+        }
+
+        // Only the one member is read and decoded
+        const hfm::ArchiveReader::Member* member =
+            reader.findMember(memberName);
+        if (member == nullptr) {
+            std::cerr << "No member named " << memberName << std::endl;
+            return -1;
+        }
+
+        std::vector<char> buffer(member->originalSize);
+        hfm::HuffmanDecoder decoder = reader.createDecoder();
+        reader.extract(*member, buffer.data(), decoder);
+
+        std::filesystem::path path =
+            std::filesystem::path(directory) /
+            hfm::ArchiveReader::getSafePath(member->name);
+        std::filesystem::create_directories(path.parent_path());
+        hfm::AsyncWriter out(path.string().c_str(), buffer.size());
+        out.write(buffer.data(), buffer.size());
+        out.finish();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
+
+int archiveList(const char* archivePath) {
+    try {
+        hfm::MappedFile file(archivePath);
+        hfm::ArchiveReader reader(file.getData(), file.getSize());
+
+        for (const auto& member : reader.getMembers()) {
+            std::cout << member.originalSize << "\t" << member.compressedSize
+                      << "\t" << member.name << "\n";
+        }
+        std::cout.flush();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
+
+int adaptiveCompress(const char* inPath, const char* outPath) {
+    hfm::AsyncReader in(inPath);
+    hfm::AsyncWriter out(outPath, in.getSize());
+
+    hfm::AdaptiveCoder coder;
+    std::vector<char> outBuff(
+        hfm::AdaptiveCoder::getMaxOutput(hfm::AsyncReader::BUFFER_SIZE));
+
+    // Output is written as the input arrives, without a first pass, while
+    // the next parts are read and the previous ones written
+    const char* inBuff = nullptr;
+    std::uint64_t read = 0;
+    while ((read = in.next(inBuff)) > 0) {
+        out.write(outBuff.data(),
+                  coder.compress(inBuff, read, outBuff.data()));
+    }
+    out.write(outBuff.data(), coder.finish(outBuff.data()));
+    out.finish();
+
+    return 0;
+}
+
+int adaptiveDecompress(const char* inPath, const char* outPath) {
+    hfm::AsyncReader in(inPath);
+    hfm::AsyncWriter out(outPath, in.getSize());
+
+    hfm::AdaptiveDecoder decoder;
+    std::vector<char> outBuff(
+        hfm::AdaptiveDecoder::getMaxOutput(hfm::AsyncReader::BUFFER_SIZE));
+
+    const char* inBuff = nullptr;
+    std::uint64_t read = 0;
+    while (!decoder.isFinished() && (read = in.next(inBuff)) > 0) {
+        out.write(outBuff.data(),
+                  decoder.decompress(inBuff, read, outBuff.data()));
+    }
+    out.finish();
+
+    if (!decoder.isFinished()) {
+        std::cerr << "Stream is truncated" << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
+
+// Calibrates on the input and writes the profile later runs load
+int autotune(const char* inPath, const char* profilePath) {
+    try {
+        const std::string path =
+            profilePath != nullptr ? profilePath
+                                   : hfm::Profile::getDefaultPath();
+        if (path.empty()) {
+            std::cerr << "No home directory, give a profile path" << std::endl;
+            return -1;
+        }
+
+        hfm::MappedFile file(inPath);
+        hfm::Autotuner tuner(std::cout);
+        hfm::Profile profile = tuner.run(file.getData(), file.getSize());
+        profile.save(path);
+
+        std::cout << "Threads " << profile.threads << ", segment size "
+                  << profile.segmentSize << ", block size "
+                  << profile.maxBlockSize << "\nProfile written to " << path
+                  << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
+
+int run(int argc, char** argv) {
     if (argc < 2) {
         printHelp();
         return -1;
@@ -48,34 +601,27 @@ int main(int argc, char** argv) {
             printHelp();
             return -1;
         } else {
-            char* buff = nullptr;
-            unsigned long buffSize = 0;
-            buffSize = std::filesystem::file_size(argv[2]);
-            buff = new char[buffSize];
+            const std::vector<char> buff = readFile(argv[2]);
 
-            std::ifstream stream(argv[2], std::ios::binary);
-            stream.read(buff, buffSize);
-            stream.close();
+            hfm::AsyncWriter out(argv[3], buff.size());
 
-            std::ofstream out(argv[3], std::ios::binary);
-
-            hfm::HuffmanCoder coder(buff, buffSize);
-            char outBuff[512];
-            long written = coder.compress(outBuff, 512);
+            hfm::HuffmanCoder coder(buff.data(), buff.size());
+            std::vector<char> outBuff(OUT_BUFF_SIZE);
+            std::int64_t written =
+                coder.compress(outBuff.data(), outBuff.size());
 
             while (written >= 0) {
-                out.write(outBuff, written);
+                out.write(outBuff.data(), written);
 
-                written = coder.compress(outBuff, 512);
+                written = coder.compress(outBuff.data(), outBuff.size());
             }
 
             if (written == -2) {
-                out.write(outBuff, sizeof(uint64_t));
+                out.write(outBuff.data(), coder.getLastBytes());
             }
 
-            out.close();
+            out.finish();
 
-            delete[] buff;
             return 0;
         }
     } else if (std::strcmp(argv[1], "-d") == 0) { // Decompression
@@ -83,36 +629,153 @@ int main(int argc, char** argv) {
             printHelp();
             return -1;
         } else {
-            char* buff = nullptr;
-            unsigned long buffSize = 0;
-            buffSize = std::filesystem::file_size(argv[2]);
-            buff = new char[buffSize];
+            const std::vector<char> buff = readFile(argv[2]);
 
-            std::ifstream stream(argv[2], std::ios::binary);
-            stream.read(buff, buffSize);
-            stream.close();
+            hfm::AsyncWriter out(argv[3], buff.size());
 
-            std::ofstream out(argv[3], std::ios::binary);
+            hfm::HuffmanDecoder coder(buff.data(), buff.size());
+            std::vector<char> outBuff(OUT_BUFF_SIZE);
+            int result = 0;
 
-            hfm::HuffmanDecoder coder(buff, buffSize);
-            char outBuff[512];
-            long written = coder.decompress(outBuff, 512);
+            try {
+                std::int64_t written =
+                    coder.decompress(outBuff.data(), outBuff.size());
 
-            while (written >= 0) {
-                out.write(outBuff, written);
+                while (written >= 0) {
+                    out.write(outBuff.data(), written);
 
-                written = coder.decompress(outBuff, 512);
-            }
+                    written = coder.decompress(outBuff.data(), outBuff.size());
+                }
 
-            if (written == -2) {
-                out.write(outBuff, coder.getLastBytes());
+                if (written == -2) {
+                    out.write(outBuff.data(), coder.getLastBytes());
+                }
+                out.finish();
+            } catch (const std::runtime_error& e) {
+                // Damaged input is reported instead of aborting
+                std::cerr << e.what() << std::endl;
+                result = -1;
             }
 
-            out.close();
+            return result;
+        }
+    } else if (std::strcmp(argv[1], "-ac") == 0) { // Adaptive compression
+        if (argc != 4) {
+            printHelp();
+            return -1;
+        }
 
-            delete[] buff;
-            return 0;
+        return adaptiveCompress(argv[2], argv[3]);
+    } else if (std::strcmp(argv[1], "-ad") == 0) { // Adaptive decompression
+        if (argc != 4) {
+            printHelp();
+            return -1;
+        }
+
+        return adaptiveDecompress(argv[2], argv[3]);
+    } else if (std::strcmp(argv[1], "-wc") == 0) { // Wide compression
+        if (argc != 4) {
+            printHelp();
+            return -1;
         }
+
+        return wideCompress(argv[2], argv[3]);
+    } else if (std::strcmp(argv[1], "-wd") == 0) { // Wide decompression
+        if (argc != 4) {
+            printHelp();
+            return -1;
+        }
+
+        return wideDecompress(argv[2], argv[3]);
+    } else if (std::strcmp(argv[1], "-bc") == 0) { // Block compression
+        if (argc != 4) {
+            printHelp();
+            return -1;
+        }
+
+        return blockCompress(argv[2], argv[3]);
+    } else if (std::strcmp(argv[1], "-bd") == 0) { // Block decompression
+        if (argc != 4) {
+            printHelp();
+            return -1;
+        }
+
+        return blockDecompress(argv[2], argv[3]);
+    } else if (std::strcmp(argv[1], "-fc") == 0) { // Frame compression
+        if (argc != 4) {
+            printHelp();
+            return -1;
+        }
+
+        return frameCompress(argv[2], argv[3]);
+    } else if (std::strcmp(argv[1], "-fd") == 0) { // Frame decompression
+        if (argc != 4) {
+            printHelp();
+            return -1;
+        }
+
+        return frameDecompress(argv[2], argv[3]);
+    } else if (std::strcmp(argv[1], "-t") == 0) { // Test
+        if (argc != 3) {
+            printHelp();
+            return -1;
+        }
+
+        return verify(argv[2]);
+    } else if (std::strcmp(argv[1], "-a") == 0 ||
+               std::strcmp(argv[1], "-as") == 0) { // Archive creation
+        if (argc < 4) {
+            printHelp();
+            return -1;
+        }
+
+        return archiveCreate(argv[2], argv + 3, argc - 3,
+                             std::strcmp(argv[1], "-as") == 0, nullptr);
+    } else if (std::strcmp(argv[1], "-at") == 0) { // Archive with a table
+        if (argc < 5) {
+            printHelp();
+            return -1;
+        }
+
+        return archiveCreate(argv[3], argv + 4, argc - 4, true, argv[2]);
+    } else if (std::strcmp(argv[1], "-am") == 0) { // Archive merging
+        if (argc < 4) {
+            printHelp();
+            return -1;
+        }
+
+        return archiveMerge(argv[2], argv + 3, argc - 3);
+    } else if (std::strcmp(argv[1], "-q") == 0 ||
+               std::strcmp(argv[1], "-qm") == 0) { // Byte counts
+        if (argc < 4) {
+            printHelp();
+            return -1;
+        }
+
+        return histogramCreate(argv[2], argv + 3, argc - 3,
+                               std::strcmp(argv[1], "-qm") == 0);
+    } else if (std::strcmp(argv[1], "-x") == 0) { // Archive extraction
+        if (argc < 3 || argc > 5) {
+            printHelp();
+            return -1;
+        }
+
+        return archiveExtract(argv[2], argc > 3 ? argv[3] : ".",
+                              argc > 4 ? argv[4] : nullptr);
+    } else if (std::strcmp(argv[1], "-l") == 0) { // Archive listing
+        if (argc != 3) {
+            printHelp();
+            return -1;
+        }
+
+        return archiveList(argv[2]);
+    } else if (std::strcmp(argv[1], "--autotune") == 0) { // Calibration
+        if (argc != 3 && argc != 4) {
+            printHelp();
+            return -1;
+        }
+
+        return autotune(argv[2], argc > 3 ? argv[3] : nullptr);
     } else if (std::strcmp(argv[1], "-h") == 0) { // Help
         printHelp();
         return 0;
@@ -125,4 +788,14 @@ int main(int argc, char** argv) {
     }
 
     return 0;
-}
\ No newline at end of file
+}
+
+int main(int argc, char** argv) {
+    // Files that cannot be opened, read or written are reported, not aborted
+    try {
+        return run(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+}
@@ -0,0 +1,138 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Corpus.hpp"
+#include <ContextPool.hpp>
+#include <HuffmanCoder.hpp>
+#include <HuffmanDecoder.hpp>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Once a thread's contexts have seen inputs of some size, coding and
+// decoding more inputs up to that size through ContextPool must not touch
+// the heap. Every allocation of the program is counted while the checked
+// calls run. Exits with 1 if any was made.
+
+namespace {
+
+bool counting            = false;
+std::uint64_t allocations = 0;
+
+}
+
+void* operator new(std::size_t size) {
+    if (counting) {
+        allocations++;
+    }
+
+    void* memory = std::malloc(size != 0 ? size : 1);
+    if (memory == nullptr) {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+namespace {
+
+constexpr std::uint64_t MAX_SIZE = 1 << 16;
+
+// Codes data and decodes it again with the contexts of the pool, returning
+// whether it came back
+bool roundTrip(const std::vector<char>& data) {
+    const std::uint64_t capacity =
+        hfm::HuffmanCoder::MAX_HEADER_SIZE + 2 * MAX_SIZE;
+    char* stream = hfm::ContextPool::getBuffer(2 * capacity);
+    char* output = stream + capacity;
+
+    hfm::HuffmanCoder& coder =
+        hfm::ContextPool::getCoder(data.data(), data.size());
+    std::uint64_t size   = 0;
+    std::int64_t written = 0;
+    while ((written = coder.compress(stream + size, capacity - size)) >= 0) {
+        size += written;
+    }
+    if (written == -2) {
+        size += coder.getLastBytes();
+    }
+
+    hfm::HuffmanDecoder& decoder =
+        hfm::ContextPool::getDecoder(stream, size);
+    std::uint64_t done = 0;
+    while ((written = decoder.decompress(output + done, MAX_SIZE - done)) >=
+           0) {
+        done += written;
+    }
+    if (written == -2) {
+        done += decoder.getLastBytes();
+    }
+
+    if (done != data.size()) {
+        return false;
+    }
+    for (std::uint64_t i = 0; i < done; i++) {
+        if (output[i] != data[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+int main() {
+    std::vector<std::vector<char>> inputs;
+    for (std::uint64_t size : {1, 100, 4095, 30000, 65536}) {
+        for (const auto& corpus : hfm::test::makeCorpora(size)) {
+            inputs.push_back(corpus.data);
+        }
+    }
+
+    // The first round may size the buffers and tables of the contexts
+    bool passed = true;
+    for (const auto& input : inputs) {
+        passed = roundTrip(input) && passed;
+    }
+
+    counting = true;
+    for (int round = 0; round < 3; round++) {
+        for (const auto& input : inputs) {
+            passed = roundTrip(input) && passed;
+        }
+    }
+    counting = false;
+
+    if (!passed) {
+        std::cerr << "FAIL round trip" << std::endl;
+        return 1;
+    }
+    if (allocations != 0) {
+        std::cerr << "FAIL " << allocations << " allocations" << std::endl;
+        return 1;
+    }
+    std::cout << "No allocations in " << 3 * inputs.size() << " round trips"
+              << std::endl;
+    return 0;
+}
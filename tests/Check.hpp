@@ -0,0 +1,36 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HFM_TEST_CHECK_HPP
+#define HFM_TEST_CHECK_HPP
+
+#include <iostream>
+#include <string>
+
+namespace hfm::test {
+
+// Checks that failed so far; tests exit with 1 if there was any
+inline int failures = 0;
+
+// Prints name if the check did not pass, and counts it
+inline void check(bool passed, const std::string& name) {
+    if (!passed) {
+        std::cerr << "FAIL " << name << std::endl;
+        failures++;
+    }
+}
+
+}
+
+#endif //! HFM_TEST_CHECK_HPP
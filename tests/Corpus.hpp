@@ -0,0 +1,159 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HFM_TEST_CORPUS_HPP
+#define HFM_TEST_CORPUS_HPP
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace hfm::test {
+
+// Deterministic inputs for the tests, one for every kind of data the coders
+// are tuned for, so results do not depend on files outside the tree
+struct Corpus {
+    std::string name;
+    std::vector<char> data;
+};
+
+class Random {
+public:
+    explicit Random(std::uint64_t seed) : m_state(seed) {}
+
+    std::uint64_t next() {
+        // xorshift64*
+        m_state ^= m_state >> 12;
+        m_state ^= m_state << 25;
+        m_state ^= m_state >> 27;
+        return m_state * 0x2545F4914F6CDD1DULL;
+    }
+
+    // Uniform in [0, 1)
+    double nextDouble() {
+        return static_cast<double>(next() >> 11) / 9007199254740992.0;
+    }
+
+private:
+    std::uint64_t m_state;
+};
+
+// Words from a small vocabulary with a Zipf-like distribution
+inline std::vector<char> makeText(std::uint64_t size, std::uint64_t seed) {
+    static const char* const words[] = {
+        "the",   "of",     "and",     "to",    "in",     "a",      "is",
+        "that",  "for",    "it",      "as",    "was",    "with",   "be",
+        "by",    "on",     "not",     "he",    "this",   "are",    "or",
+        "his",   "from",   "at",      "which", "but",    "have",   "an",
+        "had",   "they",   "you",     "were",  "their",  "one",    "all",
+        "coder", "symbol", "huffman", "block", "stream", "decode", "table"};
+    const int count = sizeof(words) / sizeof(words[0]);
+
+    Random random(seed);
+    std::vector<char> data;
+    data.reserve(size);
+    while (data.size() < size) {
+        double r  = random.nextDouble();
+        int index = static_cast<int>(count * r * r * r);
+        for (const char* c = words[index]; *c != 0 && data.size() < size;
+             c++) {
+            data.push_back(*c);
+        }
+
+        if (data.size() < size) {
+            data.push_back(random.next() % 12 == 0 ? '\n' : ' ');
+        }
+    }
+
+    return data;
+}
+
+inline std::vector<char> makeRandom(std::uint64_t size, std::uint64_t seed) {
+    Random random(seed);
+    std::vector<char> data(size);
+    for (auto& byte : data) {
+        byte = static_cast<char>(random.next() >> 56);
+    }
+
+    return data;
+}
+
+// Mostly zeros, with short random bursts
+inline std::vector<char> makeSparse(std::uint64_t size, std::uint64_t seed) {
+    Random random(seed);
+    std::vector<char> data;
+    data.reserve(size);
+    while (data.size() < size) {
+        std::uint64_t run = random.next() % 400 + 5;
+        data.insert(data.end(), std::min(run, size - data.size()), 0);
+
+        std::uint64_t burst = random.next() % 40 + 1;
+        for (std::uint64_t i = 0; i < burst && data.size() < size; i++) {
+            data.push_back(static_cast<char>(random.next() >> 56));
+        }
+    }
+
+    return data;
+}
+
+// Geometrically distributed bytes, most of them small
+inline std::vector<char> makeSkewed(std::uint64_t size, std::uint64_t seed) {
+    Random random(seed);
+    std::vector<char> data(size);
+    for (auto& byte : data) {
+        double r = random.nextDouble();
+        byte     = static_cast<char>(
+            std::min(255.0, std::floor(-std::log(1 - r) * 2)));
+    }
+
+    return data;
+}
+
+// A slowly drifting sensor reading
+inline std::vector<char> makeSensor(std::uint64_t size, std::uint64_t seed) {
+    Random random(seed);
+    std::vector<char> data(size);
+    int value = 128;
+    for (auto& byte : data) {
+        value += static_cast<int>(random.next() % 5) - 2;
+        value = std::max(0, std::min(255, value));
+        byte  = static_cast<char>(value);
+    }
+
+    return data;
+}
+
+// Every corpus class, each size bytes long
+inline std::vector<Corpus> makeCorpora(std::uint64_t size) {
+    std::vector<Corpus> corpora;
+    corpora.push_back({"text", makeText(size, 1)});
+    corpora.push_back({"random", makeRandom(size, 2)});
+    corpora.push_back({"sparse", makeSparse(size, 3)});
+    corpora.push_back({"skewed", makeSkewed(size, 4)});
+    corpora.push_back({"sensor", makeSensor(size, 5)});
+
+    // Text followed by random data, so the block splitter has work to do
+    std::vector<char> mixed = makeText(size / 2, 6);
+    std::vector<char> tail  = makeRandom(size - size / 2, 7);
+    mixed.insert(mixed.end(), tail.begin(), tail.end());
+    corpora.push_back({"mixed", mixed});
+
+    return corpora;
+}
+
+}
+
+#endif //! HFM_TEST_CORPUS_HPP
@@ -0,0 +1,265 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Check.hpp"
+#include "Corpus.hpp"
+#include <IoBackend.hpp>
+#include <AsyncReader.hpp>
+#include <AsyncWriter.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cstdint>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// Files written and read through AsyncWriter and AsyncReader must come back
+// unchanged with whichever backend IoBackend::create() picks (run once more
+// with HFM_IO=threads), also when completions arrive out of order and
+// transfers stop short. Prints each failure and exits with 1 if there was
+// any, or with 77 on systems without a backend.
+
+namespace {
+
+using hfm::test::check;
+using hfm::test::failures;
+
+// Wraps a real backend, hands completions back newest first once every
+// running request has finished, and reports every transfer of more than a
+// block as stopping early, so callers have to submit the rest again.
+// With ended set, every transfer reports the end of the file instead.
+class ShuffledBackend : public hfm::IoBackend {
+public:
+    ShuffledBackend(std::unique_ptr<IoBackend> backend, bool ended = false)
+        : m_backend(std::move(backend)), m_ended(ended), m_running(0) {
+    }
+
+    const char* getName() const override {
+        return "shuffled";
+    }
+
+    void submit(const Request& request) override {
+        m_backend->submit(request);
+        m_running++;
+    }
+
+    void flush() override {
+        m_backend->flush();
+    }
+
+    Completion wait() override {
+        while (m_running > 0) {
+            Completion completion = m_backend->wait();
+            m_running--;
+            if (m_ended) {
+                completion.result = 0;
+            } else if (completion.result > LONG) {
+                completion.result -= SHORT;
+            }
+            m_done.push_back(completion);
+        }
+
+        Completion completion = m_done.back();
+        m_done.pop_back();
+        return completion;
+    }
+
+private:
+    // Bytes cut from each transfer, not a multiple of any alignment. Only
+    // longer transfers are cut, so the rest repeated from an aligned offset
+    // still moves forward under O_DIRECT.
+    static constexpr std::int64_t SHORT = 1000;
+    static constexpr std::int64_t LONG  = ALIGNMENT + SHORT;
+
+    std::unique_ptr<IoBackend> m_backend;
+    bool m_ended;
+    unsigned int m_running;
+    std::vector<Completion> m_done;
+};
+
+std::string tempPath(const std::string& name) {
+    return (std::filesystem::temp_directory_path() / ("hfm-io-" + name))
+        .string();
+}
+
+std::vector<char> readBack(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(in),
+                             std::istreambuf_iterator<char>());
+}
+
+// Many reads at once, of parts of a file and past its end, each buffer
+// checked against the tag of its completion
+void checkBackend() {
+    const std::vector<char> data = hfm::test::makeRandom(100000, 7);
+    const std::string path       = tempPath("backend");
+    {
+        std::ofstream out(path, std::ios::binary);
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+    }
+
+    const unsigned int depth = 4;
+    std::unique_ptr<hfm::IoBackend> backend = hfm::IoBackend::create(depth);
+    const int fd = open(path.c_str(), O_RDONLY);
+    check(fd >= 0, "backend open");
+
+    // Twice the depth, so the queue fills before the first flush
+    const unsigned int count = 2 * depth;
+    const std::uint64_t part = 13001;
+    std::vector<std::vector<char>> buffers(count, std::vector<char>(part));
+    for (unsigned int i = 0; i < count; i++) {
+        hfm::IoBackend::Request request;
+        request.fd     = fd;
+        request.buffer = buffers[i].data();
+        request.size   = part;
+        request.offset = (count - 1 - i) * part;
+        request.write  = false;
+        request.tag    = i;
+        backend->submit(request);
+    }
+
+    std::vector<bool> seen(count, false);
+    for (unsigned int i = 0; i < count; i++) {
+        hfm::IoBackend::Completion completion = backend->wait();
+        const std::uint64_t tag = completion.tag;
+        if (tag >= count || seen[tag]) {
+            check(false, "backend tag " + std::to_string(tag));
+            continue;
+        }
+        seen[tag] = true;
+
+        // The last part reaches past the end of the file
+        const std::uint64_t offset   = (count - 1 - tag) * part;
+        const std::uint64_t expected =
+            std::min<std::uint64_t>(part, data.size() - offset);
+        check(completion.result == static_cast<std::int64_t>(expected),
+              "backend size " + std::to_string(tag));
+        check(std::equal(data.begin() + offset,
+                         data.begin() + offset + expected,
+                         buffers[tag].begin()),
+              "backend data " + std::to_string(tag));
+    }
+    close(fd);
+    std::filesystem::remove(path);
+}
+
+void checkFile(std::uint64_t size, bool shuffled, const std::string& name) {
+    const std::vector<char> data = hfm::test::makeText(size, size);
+    const std::string path       = tempPath("file");
+
+    auto backend = [shuffled]() -> std::unique_ptr<hfm::IoBackend> {
+        std::unique_ptr<hfm::IoBackend> backend =
+            hfm::IoBackend::create(hfm::AsyncWriter::DEPTH);
+        if (shuffled) {
+            return std::make_unique<ShuffledBackend>(std::move(backend));
+        }
+        return backend;
+    };
+
+    try {
+        hfm::AsyncWriter writer(path.c_str(), size, backend());
+        // Uneven pieces, so buffers are filled across calls
+        for (std::uint64_t done = 0; done < size;) {
+            const std::uint64_t count =
+                std::min<std::uint64_t>(size - done, 77777);
+            writer.write(data.data() + done, count);
+            done += count;
+        }
+        writer.finish();
+        check(readBack(path) == data, name + " write");
+
+        hfm::AsyncReader reader(path.c_str(), backend());
+        check(reader.getSize() == size, name + " size");
+        std::vector<char> read;
+        const char* part;
+        while (std::uint64_t count = reader.next(part)) {
+            read.insert(read.end(), part, part + count);
+        }
+        check(read == data, name + " read");
+    } catch (const std::exception& e) {
+        check(false, name + ": " + e.what());
+    }
+    std::filesystem::remove(path);
+}
+
+// A file that ends early while it is read must fail, not return garbage
+void checkTruncated() {
+    const std::uint64_t size = 3 * hfm::AsyncReader::BUFFER_SIZE;
+    const std::string path   = tempPath("truncated");
+    {
+        const std::vector<char> data = hfm::test::makeRandom(size, 3);
+        std::ofstream out(path, std::ios::binary);
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+    }
+
+    bool thrown = false;
+    try {
+        hfm::AsyncReader reader(
+            path.c_str(),
+            std::make_unique<ShuffledBackend>(
+                hfm::IoBackend::create(hfm::AsyncReader::DEPTH), true));
+        const char* part;
+        while (reader.next(part) > 0) {
+        }
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    check(thrown, "truncated read");
+    std::filesystem::remove(path);
+}
+
+}
+
+int main() {
+    std::unique_ptr<hfm::IoBackend> backend = hfm::IoBackend::create(1);
+    if (!backend) {
+        std::cout << "No I/O backend on this system" << std::endl;
+        return 77;
+    }
+    std::cout << "Backend: " << backend->getName() << std::endl;
+
+    checkBackend();
+
+    const std::uint64_t buffer = hfm::AsyncWriter::BUFFER_SIZE;
+    const std::uint64_t sizes[] = {0, 1, 4095, 4096, buffer - 1, buffer,
+                                   5 * buffer + 12345};
+    for (std::uint64_t size : sizes) {
+        checkFile(size, false, "file " + std::to_string(size));
+        checkFile(size, true, "shuffled file " + std::to_string(size));
+    }
+
+    // Large enough for O_DIRECT, where the file system supports it, with
+    // short transfers that have to be repeated from an aligned offset
+    setenv("HFM_DIRECT", "1", 1);
+    const std::uint64_t direct = hfm::IoBackend::DIRECT_THRESHOLD + 12345;
+    checkFile(direct, true, "direct file");
+    unsetenv("HFM_DIRECT");
+
+    checkTruncated();
+
+    if (failures > 0) {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All checks passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,115 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Check.hpp"
+#include <HuffmanCoder.hpp>
+#include <HuffmanDecoder.hpp>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #include <sys/mman.h>
+#endif
+
+// Round trips of inputs over 4 GiB, where counts, sizes and offsets no
+// longer fit 32 bits: one byte value only, and the same with a second byte
+// value sprinkled in. The input is an anonymous mapping, so the zero bytes
+// take no memory, and the output is compared part by part. Needs about
+// 1.5 GiB of memory and takes a while, so it is only built with
+// HFM_LARGE_TESTS. Exits with 1 on a failure, or with 77 on systems
+// without mmap.
+
+namespace {
+
+constexpr std::uint64_t SIZE   = (4ULL << 30) + 4097;
+constexpr std::uint64_t STRIDE = 1 << 20; // Between bytes of the second value
+constexpr std::uint64_t CHUNK  = 64 << 20;
+
+using hfm::test::check;
+using hfm::test::failures;
+
+void checkRoundTrip(const char* data, const std::string& name) {
+    std::vector<char> stream;
+    {
+        hfm::HuffmanCoder coder(data, SIZE);
+        stream.reserve(coder.getCompressedSize());
+        std::vector<char> buffer(CHUNK);
+        std::int64_t written = 0;
+        while ((written = coder.compress(buffer.data(), CHUNK)) >= 0) {
+            stream.insert(stream.end(), buffer.begin(),
+                          buffer.begin() + written);
+        }
+        if (written == -2) {
+            stream.insert(stream.end(), buffer.begin(),
+                          buffer.begin() + coder.getLastBytes());
+        }
+    }
+    std::cout << name << ": " << SIZE << " bytes into " << stream.size()
+              << std::endl;
+
+    hfm::HuffmanDecoder decoder(stream.data(), stream.size());
+    std::vector<char> buffer(CHUNK);
+    std::uint64_t done = 0;
+    bool same          = true;
+    std::int64_t written = 0;
+    while (same &&
+           (written = decoder.decompress(buffer.data(), CHUNK)) >= 0) {
+        same = done + written <= SIZE &&
+               std::equal(buffer.begin(), buffer.begin() + written,
+                          data + done);
+        done += written;
+    }
+    if (same && written == -2) {
+        const std::uint64_t last = decoder.getLastBytes();
+        same = done + last <= SIZE &&
+               std::equal(buffer.begin(), buffer.begin() + last, data + done);
+        done += last;
+    }
+    check(same && done == SIZE, name);
+}
+
+}
+
+int main() {
+#if defined(__unix__) || defined(__APPLE__)
+    void* mapped = mmap(nullptr, SIZE, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "Unable to map " << SIZE << " bytes" << std::endl;
+        return 1;
+    }
+    char* data = static_cast<char*>(mapped);
+
+    checkRoundTrip(data, "one symbol");
+
+    for (std::uint64_t i = STRIDE / 2; i < SIZE; i += STRIDE) {
+        data[i] = 'b';
+    }
+    checkRoundTrip(data, "two symbols");
+    munmap(mapped, SIZE);
+
+    if (failures > 0) {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All checks passed" << std::endl;
+    return 0;
+#else
+    std::cout << "No anonymous mappings on this system" << std::endl;
+    return 77;
+#endif
+}
@@ -0,0 +1,862 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Check.hpp"
+#include "Corpus.hpp"
+#include <HuffmanCoder.hpp>
+#include <HuffmanDecoder.hpp>
+#include <AdaptiveCoder.hpp>
+#include <AdaptiveDecoder.hpp>
+#include <WideCoder.hpp>
+#include <WideDecoder.hpp>
+#include <BlockCoder.hpp>
+#include <BlockDecoder.hpp>
+#include <FrameCoder.hpp>
+#include <FrameDecoder.hpp>
+#include <ArchiveWriter.hpp>
+#include <ArchiveReader.hpp>
+#include <Histogram.hpp>
+#include <ByteOrder.hpp>
+#include <CodeBuilder.hpp>
+#include <JobPool.hpp>
+#include <ContextPool.hpp>
+#include <Profile.hpp>
+#include <Kernels.hpp>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Every coder must give back exactly its input, for every kind of data and
+// for the edge cases of the bit stream. Prints each failure and exits with
+// 1 if there was any.
+
+namespace {
+
+using hfm::test::check;
+using hfm::test::failures;
+
+std::vector<char> huffmanCompress(const std::vector<char>& data,
+                                  std::uint64_t chunk) {
+    hfm::HuffmanCoder coder(data.data(), data.size());
+    std::vector<char> stream;
+    std::vector<char> buffer(chunk);
+
+    std::int64_t written = 0;
+    while ((written = coder.compress(buffer.data(), chunk)) >= 0) {
+        stream.insert(stream.end(), buffer.begin(), buffer.begin() + written);
+    }
+
+    if (written == -2) {
+        stream.insert(stream.end(), buffer.begin(),
+                      buffer.begin() + coder.getLastBytes());
+    }
+
+    return stream;
+}
+
+std::vector<char> huffmanDecompress(const std::vector<char>& stream,
+                                    std::uint64_t chunk) {
+    hfm::HuffmanDecoder decoder(stream.data(), stream.size());
+    std::vector<char> data;
+    std::vector<char> buffer(chunk);
+
+    std::int64_t written = 0;
+    while ((written = decoder.decompress(buffer.data(), chunk)) >= 0) {
+        data.insert(data.end(), buffer.begin(), buffer.begin() + written);
+    }
+
+    if (written == -2) {
+        data.insert(data.end(), buffer.begin(),
+                    buffer.begin() + decoder.getLastBytes());
+    }
+
+    return data;
+}
+
+void checkHuffman(const std::vector<char>& data, const std::string& name) {
+    // Whole buffers, and output chunks just above the largest header
+    const std::uint64_t small = hfm::HuffmanCoder::MAX_HEADER_SIZE + 64;
+    const std::uint64_t large = data.size() * 2 + (1 << 16);
+
+    try {
+        std::vector<char> stream = huffmanCompress(data, large);
+        check(huffmanDecompress(stream, large) == data, "huffman " + name);
+        check(huffmanDecompress(stream, 1) == data,
+              "huffman byte at a time " + name);
+        check(huffmanCompress(data, small) == stream,
+              "huffman small output " + name);
+
+        // The stream ends with the last byte holding bits, not a whole word
+        hfm::HuffmanCoder coder(data.data(), data.size());
+        check(stream.size() == coder.getCompressedSize(),
+              "huffman size " + name);
+    } catch (const std::exception& e) {
+        check(false, "huffman " + name + ": " + e.what());
+    }
+
+    // Room for the size and symbol count only, which fits the header of
+    // empty input but no dictionary. Nothing may be written past it.
+    const std::uint64_t header = sizeof(std::uint64_t) + sizeof(std::uint16_t);
+    std::vector<char> guarded(header + 64, 'g');
+    bool thrown = false;
+    try {
+        hfm::HuffmanCoder coder(data.data(), data.size());
+        coder.compress(guarded.data(), header);
+    } catch (const std::length_error&) {
+        thrown = true;
+    }
+    check(thrown == !data.empty(), "huffman header room " + name);
+    check(std::all_of(guarded.begin() + header, guarded.end(),
+                      [](char c) { return c == 'g'; }),
+          "huffman header overflow " + name);
+}
+
+void checkBlocks(const std::vector<char>& data, const std::string& name) {
+    try {
+        hfm::BlockCoder coder(data.data(), data.size());
+        std::vector<char> stream;
+        std::vector<char> buffer(hfm::BlockCoder::MAX_OUTPUT);
+        std::int64_t written = 0;
+        while ((written = coder.compress(buffer.data(), buffer.size())) >= 0) {
+            stream.insert(stream.end(), buffer.begin(),
+                          buffer.begin() + written);
+        }
+
+        hfm::BlockDecoder decoder(stream.data(), stream.size());
+        std::vector<char> output(hfm::BlockFormat::MAX_BLOCK_SIZE);
+        std::vector<char> result;
+        while ((written = decoder.decompress(output.data(),
+                                             output.size())) >= 0) {
+            result.insert(result.end(), output.begin(),
+                          output.begin() + written);
+        }
+
+        check(result == data, "blocks " + name);
+        check(decoder.verify(4) == data.size(), "blocks verify " + name);
+    } catch (const std::exception& e) {
+        check(false, "blocks " + name + ": " + e.what());
+    }
+}
+
+void checkFrame(const std::vector<char>& data, const std::string& name) {
+    try {
+        hfm::FrameCoder coder;
+        std::vector<char> frame(hfm::FrameCoder::getMaxOutput(data.size()));
+        frame.resize(coder.compress(data.data(), data.size(), frame.data()));
+        check(frame.size() <= data.size() + hfm::FrameCoder::MAX_OVERHEAD,
+              "frame overhead " + name);
+
+        hfm::FrameDecoder decoder;
+        std::vector<char> result(
+            hfm::FrameDecoder::getOriginalSize(frame.data(), frame.size()));
+        check(decoder.decompress(frame.data(), frame.size(),
+                                 result.data()) == frame.size(),
+              "frame size " + name);
+        check(result == data, "frame " + name);
+    } catch (const std::exception& e) {
+        check(false, "frame " + name + ": " + e.what());
+    }
+}
+
+// Input is given to the coder and the stream to the decoder in pieces of
+// the given size
+std::vector<char> adaptiveCompress(const std::vector<char>& data,
+                                   std::uint64_t piece) {
+    hfm::AdaptiveCoder coder;
+    std::vector<char> stream;
+    std::vector<char> buffer(hfm::AdaptiveCoder::getMaxOutput(piece));
+    for (std::uint64_t done = 0; done < data.size(); done += piece) {
+        const std::uint64_t count = std::min(piece, data.size() - done);
+        const std::uint64_t written =
+            coder.compress(data.data() + done, count, buffer.data());
+        stream.insert(stream.end(), buffer.begin(), buffer.begin() + written);
+    }
+    const std::uint64_t written = coder.finish(buffer.data());
+    stream.insert(stream.end(), buffer.begin(), buffer.begin() + written);
+
+    return stream;
+}
+
+std::vector<char> adaptiveDecompress(const std::vector<char>& stream,
+                                     std::uint64_t piece) {
+    hfm::AdaptiveDecoder decoder;
+    std::vector<char> data;
+    std::vector<char> buffer(hfm::AdaptiveDecoder::getMaxOutput(piece));
+    for (std::uint64_t done = 0; done < stream.size(); done += piece) {
+        const std::uint64_t count = std::min(piece, stream.size() - done);
+        const std::uint64_t written =
+            decoder.decompress(stream.data() + done, count, buffer.data());
+        data.insert(data.end(), buffer.begin(), buffer.begin() + written);
+    }
+    if (!decoder.isFinished()) {
+        throw std::runtime_error("Adaptive stream has no end");
+    }
+
+    return data;
+}
+
+void checkAdaptive(const std::vector<char>& data, const std::string& name) {
+    try {
+        std::vector<char> stream = adaptiveCompress(data, 1 << 16);
+        check(adaptiveDecompress(stream, 1 << 16) == data, "adaptive " + name);
+        check(adaptiveDecompress(stream, 1) == data,
+              "adaptive byte at a time " + name);
+        check(adaptiveCompress(data, 1000) == stream,
+              "adaptive small input " + name);
+    } catch (const std::exception& e) {
+        check(false, "adaptive " + name + ": " + e.what());
+    }
+}
+
+// Sections of different kinds, long enough for the rebuild interval to
+// reach its maximum and the counts to be halved several times, must come
+// back, and the codes must follow the change of kind. Flushes in the
+// middle must not disturb the model.
+void checkAdaptiveSections() {
+    const std::uint64_t size = 300000;
+    std::vector<char> data   = hfm::test::makeRandom(size, 1);
+    const std::vector<char> skewed = hfm::test::makeSkewed(size, 2);
+    const std::vector<char> text   = hfm::test::makeText(size, 3);
+    const std::vector<char> single(size, 'a');
+    const std::vector<char> random = data;
+    data.insert(data.end(), skewed.begin(), skewed.end());
+    data.insert(data.end(), text.begin(), text.end());
+    data.insert(data.end(), single.begin(), single.end());
+
+    try {
+        std::vector<char> stream = adaptiveCompress(data, 1 << 16);
+        check(adaptiveDecompress(stream, 4093) == data, "adaptive sections");
+
+        // After random bytes a single byte value costs 8 bits, until the
+        // halved counts let its code shrink to 1 bit
+        std::vector<char> settled = random;
+        settled.insert(settled.end(), single.begin(), single.end());
+        const std::uint64_t cost = adaptiveCompress(settled, 1 << 16).size() -
+                                   adaptiveCompress(random, 1 << 16).size();
+        check(cost < size / 4,
+              "adaptive sections follow the data " + std::to_string(cost));
+
+        hfm::AdaptiveCoder coder;
+        std::vector<char> flushed;
+        std::vector<char> buffer(hfm::AdaptiveCoder::getMaxOutput(10007));
+        for (std::uint64_t done = 0; done < data.size(); done += 10007) {
+            const std::uint64_t count =
+                std::min<std::uint64_t>(10007, data.size() - done);
+            std::uint64_t written =
+                coder.compress(data.data() + done, count, buffer.data());
+            written += coder.flush(buffer.data() + written);
+            flushed.insert(flushed.end(), buffer.begin(),
+                           buffer.begin() + written);
+        }
+        const std::uint64_t written = coder.finish(buffer.data());
+        flushed.insert(flushed.end(), buffer.begin(),
+                       buffer.begin() + written);
+        check(adaptiveDecompress(flushed, 1 << 16) == data,
+              "adaptive flushed sections");
+    } catch (const std::exception& e) {
+        check(false, std::string("adaptive sections: ") + e.what());
+    }
+}
+
+// A cut stream never reaches its end, and gives back no more than a part
+// of the input from its start
+void checkAdaptiveTruncated() {
+    const std::vector<char> data = hfm::test::makeText(3000, 4);
+    const std::vector<char> stream = adaptiveCompress(data, 1 << 16);
+    for (std::uint64_t size = 0; size < stream.size(); size++) {
+        bool passed = true;
+        try {
+            hfm::AdaptiveDecoder decoder;
+            std::vector<char> result(
+                hfm::AdaptiveDecoder::getMaxOutput(size));
+            result.resize(
+                decoder.decompress(stream.data(), size, result.data()));
+            passed = !decoder.isFinished() && result.size() <= data.size() &&
+                     std::equal(result.begin(), result.end(), data.begin());
+        } catch (const std::runtime_error&) {
+        }
+        check(passed, "adaptive truncated at " + std::to_string(size));
+    }
+}
+
+std::vector<char> wideCompress(const std::vector<char>& data,
+                               std::uint64_t chunk) {
+    hfm::WideCoder coder(data.data(), data.size());
+    std::vector<char> stream;
+    std::vector<char> buffer(chunk);
+
+    std::int64_t written = 0;
+    while ((written = coder.compress(buffer.data(), chunk)) >= 0) {
+        stream.insert(stream.end(), buffer.begin(), buffer.begin() + written);
+    }
+
+    return stream;
+}
+
+std::vector<char> wideDecompress(const std::vector<char>& stream,
+                                 std::uint64_t chunk) {
+    hfm::WideDecoder decoder(stream.data(), stream.size());
+    std::vector<char> data;
+    std::vector<char> buffer(chunk);
+
+    std::int64_t written = 0;
+    while ((written = decoder.decompress(buffer.data(), chunk)) >= 0) {
+        data.insert(data.end(), buffer.begin(), buffer.begin() + written);
+    }
+
+    return data;
+}
+
+void checkWide(const std::vector<char>& data, const std::string& name) {
+    // Output chunks of the smallest size take the odd last byte alone
+    const std::uint64_t large =
+        hfm::WideCoder::MAX_HEADER_SIZE + data.size() * 3;
+
+    try {
+        std::vector<char> stream = wideCompress(data, large);
+        check(wideDecompress(stream, large) == data, "wide " + name);
+        check(wideDecompress(stream, 2) == data, "wide pairs " + name);
+        check(wideDecompress(stream, 3) == data, "wide odd output " + name);
+    } catch (const std::exception& e) {
+        check(false, "wide " + name + ": " + e.what());
+    }
+}
+
+// Pair counts of the Fibonacci sequence give the deepest possible tree, so
+// codes reach MAX_BITS and decoding goes past the lookup table. A thousand
+// pairs seen once, and an odd last byte, come on top.
+void checkWideLongCodes() {
+    std::vector<char> data;
+    std::uint64_t previous = 1;
+    std::uint64_t count    = 1;
+    for (int pair = 0; pair < 26; pair++) {
+        for (std::uint64_t i = 0; i < count; i++) {
+            data.push_back('a' + pair);
+            data.push_back('A' + pair % 4);
+        }
+        const std::uint64_t next = previous + count;
+        previous                 = count;
+        count                    = next;
+    }
+    for (int pair = 0; pair < 1000; pair++) {
+        data.push_back(static_cast<char>(0x80 + pair % 100));
+        data.push_back(static_cast<char>(0x80 + pair / 100));
+    }
+    data.push_back('z');
+
+    try {
+        std::vector<char> stream = wideCompress(data, 1 << 20);
+
+        // Header: size (u64), symbol count (u32), then value (u16) and
+        // length (u8) of every symbol
+        const std::uint32_t symbols = hfm::readLE32(stream.data() + 8);
+        unsigned int longest = 0;
+        for (std::uint32_t i = 0; i < symbols; i++) {
+            longest = std::max<unsigned int>(
+                longest, static_cast<unsigned char>(stream[12 + i * 3 + 2]));
+        }
+        check(longest > 16 && longest <= hfm::WideCoder::MAX_BITS,
+              "wide long codes length " + std::to_string(longest));
+
+        check(wideDecompress(stream, 1 << 20) == data, "wide long codes");
+        check(wideDecompress(stream, 3) == data, "wide long codes odd output");
+    } catch (const std::exception& e) {
+        check(false, std::string("wide long codes: ") + e.what());
+    }
+}
+
+// One member, read back from memory and extracted to a file
+void checkArchive(const std::vector<char>& data, const std::string& name) {
+    const std::filesystem::path directory =
+        std::filesystem::temp_directory_path() / "hfm-test-archive";
+    try {
+        std::ostringstream out;
+        hfm::ArchiveWriter writer(out);
+        writer.addMember("member", data.data(), data.size());
+        writer.finish();
+
+        const std::string archive = out.str();
+        hfm::ArchiveReader reader(archive.data(), archive.size());
+        const hfm::ArchiveReader::Member* member =
+            reader.findMember("member");
+        check(member != nullptr && member->originalSize == data.size(),
+              "archive member " + name);
+        if (member != nullptr) {
+            std::vector<char> result(member->originalSize);
+            hfm::HuffmanDecoder decoder = reader.createDecoder();
+            reader.extract(*member, result.data(), decoder);
+            check(result == data, "archive " + name);
+        }
+
+        reader.extractAll(directory, 1);
+        std::ifstream in(directory / "member", std::ios::binary);
+        check(std::vector<char>(std::istreambuf_iterator<char>(in),
+                                std::istreambuf_iterator<char>()) == data,
+              "archive extracted " + name);
+    } catch (const std::exception& e) {
+        check(false, "archive " + name + ": " + e.what());
+    }
+    std::filesystem::remove_all(directory);
+}
+
+void checkAll(const std::vector<char>& data, const std::string& name) {
+    checkHuffman(data, name);
+    checkBlocks(data, name);
+    checkFrame(data, name);
+    checkAdaptive(data, name);
+    checkWide(data, name);
+    checkArchive(data, name);
+}
+
+// Shards are counted apart, the serialized counts merged, every shard
+// archived on its own with the merged table, and the archives merged
+// without coding the members again
+void checkShards(const std::vector<hfm::test::Corpus>& shards) {
+    try {
+        hfm::Histogram merged;
+        for (const auto& shard : shards) {
+            hfm::Histogram part;
+            part.add(shard.data.data(), shard.data.size());
+            char buff[hfm::Histogram::MAX_SERIALIZED_SIZE];
+            merged.merge(
+                hfm::Histogram::deserialize(buff, part.serialize(buff)));
+        }
+
+        std::vector<std::string> archives;
+        for (const auto& shard : shards) {
+            std::ostringstream out;
+            hfm::ArchiveWriter writer(out);
+            writer.setSharedTable(merged, UINT64_MAX);
+            writer.addMember(shard.name, shard.data.data(), shard.data.size());
+            writer.finish();
+            archives.push_back(out.str());
+        }
+
+        // Equal counts give equal codes, so the shards fit the table
+        std::ostringstream out;
+        hfm::ArchiveWriter writer(out);
+        writer.setSharedTable(merged);
+        for (const auto& archive : archives) {
+            hfm::ArchiveReader reader(archive.data(), archive.size());
+            for (const auto& member : reader.getMembers()) {
+                writer.copyMember(reader, member);
+            }
+        }
+        writer.finish();
+
+        const std::string archive = out.str();
+        hfm::ArchiveReader reader(archive.data(), archive.size());
+        hfm::HuffmanDecoder decoder = reader.createDecoder();
+        check(reader.getMembers().size() == shards.size(), "shard count");
+        for (std::size_t i = 0; i < reader.getMembers().size(); i++) {
+            const auto& member = reader.getMembers()[i];
+            std::vector<char> result(member.originalSize);
+            reader.extract(member, result.data(), decoder);
+            check(result == shards[i].data, "shard " + shards[i].name);
+        }
+
+        std::uint64_t total = 0;
+        for (const auto& shard : shards) {
+            total += shard.data.size();
+        }
+        check(reader.verify(2) == total, "shards verify");
+
+        // A damaged member fails the check of the whole archive
+        std::string damaged = archive;
+        const auto& first   = reader.getMembers()[0];
+        damaged[first.offset + first.compressedSize / 2] ^= 0x55;
+        hfm::ArchiveReader damagedReader(damaged.data(), damaged.size());
+        bool thrown = false;
+        try {
+            damagedReader.verify(2);
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        check(thrown, "shards verify damaged");
+    } catch (const std::exception& e) {
+        check(false, std::string("shards: ") + e.what());
+    }
+}
+
+// Merged counts stay within what deserialize() accepts, or the merge is
+// refused as a whole
+void checkHistogramLimit() {
+    std::uint64_t counts[hfm::Histogram::SYMBOLS] = {};
+    counts['a'] = 1ULL << 55;
+    counts['b'] = 1ULL << 55;
+
+    try {
+        char buff[hfm::Histogram::MAX_SERIALIZED_SIZE];
+        const hfm::Histogram full = hfm::Histogram::deserialize(
+            buff, hfm::Histogram(counts).serialize(buff));
+        hfm::Histogram merged;
+        merged.merge(full);
+
+        bool thrown = false;
+        try {
+            merged.merge(full);
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        check(thrown, "histogram merge overflow");
+        check(merged.getTotal() == full.getTotal(),
+              "histogram merge overflow unchanged");
+    } catch (const std::exception& e) {
+        check(false, std::string("histogram limit: ") + e.what());
+    }
+}
+
+// Jobs of every size, several segments included, come back whole and in
+// the container format, damaged input fails its future, and a full pool
+// refuses jobs until one has completed
+void checkJobs() {
+    hfm::JobPool pool(4, 8);
+    const std::uint64_t sizes[] = {0, 1, 100000,
+                                   2 * hfm::JobPool::SEGMENT_SIZE + 12345};
+    for (std::uint64_t size : sizes) {
+        std::vector<std::future<std::vector<char>>> results;
+        std::vector<hfm::test::Corpus> corpora = hfm::test::makeCorpora(size);
+        for (const auto& corpus : corpora) {
+            results.push_back(
+                pool.submit(hfm::JobPool::COMPRESS, corpus.data));
+        }
+
+        for (std::size_t i = 0; i < corpora.size(); i++) {
+            const std::string name =
+                "job " + corpora[i].name + " " + std::to_string(size);
+            try {
+                std::vector<char> stream = results[i].get();
+                hfm::BlockDecoder decoder(stream.data(), stream.size());
+                check(decoder.verify(1) == size, name + " container");
+                check(pool.submit(hfm::JobPool::DECOMPRESS, stream).get() ==
+                          corpora[i].data,
+                      name);
+            } catch (const std::exception& e) {
+                check(false, name + ": " + e.what());
+            }
+        }
+    }
+
+    std::vector<char> text = hfm::test::makeText(100000, 3);
+    try {
+        check(pool.submit(hfm::JobPool::DECOMPRESS,
+                          huffmanCompress(text, 1 << 16))
+                      .get() == text,
+              "job stream");
+    } catch (const std::exception& e) {
+        check(false, std::string("job stream: ") + e.what());
+    }
+
+    std::vector<char> damaged =
+        pool.submit(hfm::JobPool::COMPRESS, text).get();
+    damaged.resize(damaged.size() / 2);
+    bool thrown = false;
+    try {
+        pool.submit(hfm::JobPool::DECOMPRESS, damaged).get();
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    check(thrown, "job damaged");
+
+    // Settings an autotuned profile can pick
+    hfm::JobPool tuned(2, 4);
+    tuned.setSegmentSize(1 << 20);
+    tuned.setMaxBlockSize(64 << 10);
+    for (const auto& corpus : hfm::test::makeCorpora(3 << 20)) {
+        try {
+            std::vector<char> stream =
+                tuned.submit(hfm::JobPool::COMPRESS, corpus.data).get();
+            check(tuned.submit(hfm::JobPool::DECOMPRESS, stream).get() ==
+                      corpus.data,
+                  "tuned job " + corpus.name);
+        } catch (const std::exception& e) {
+            check(false, "tuned job " + corpus.name + ": " + e.what());
+        }
+    }
+
+    // The first job holds the only slot until its callback returns
+    hfm::JobPool single(1, 1);
+    std::promise<void> gate;
+    std::shared_future<void> opened = gate.get_future().share();
+    std::vector<char> input = text;
+    check(single.trySubmit(hfm::JobPool::COMPRESS, std::move(input),
+                           [opened](std::vector<char>, std::exception_ptr) {
+                               opened.wait();
+                           }),
+          "job accepted");
+    input = text;
+    check(!single.trySubmit(hfm::JobPool::COMPRESS, std::move(input),
+                            [](std::vector<char>, std::exception_ptr) {}),
+          "job refused");
+    check(input == text, "refused job input");
+    gate.set_value();
+    single.wait();
+    check(single.trySubmit(hfm::JobPool::COMPRESS, std::move(input),
+                           [](std::vector<char>, std::exception_ptr) {}),
+          "job accepted after completion");
+}
+
+// Two members of one name would be extracted to the same file, so neither
+// the writer nor the reader accepts them
+void checkArchiveDuplicates() {
+    const std::vector<char> data = hfm::test::makeText(1000, 5);
+    std::ostringstream out;
+    hfm::ArchiveWriter writer(out);
+    writer.addMember("aa", data.data(), data.size());
+    writer.addMember("ab", data.data(), data.size());
+
+    bool thrown = false;
+    try {
+        writer.addMember("aa", data.data(), data.size());
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    check(thrown, "archive duplicate added");
+    writer.finish();
+
+    std::string archive = out.str();
+    hfm::ArchiveReader reader(archive.data(), archive.size());
+    std::ostringstream copy;
+    hfm::ArchiveWriter copier(copy);
+    copier.copyMember(reader, reader.getMembers()[0]);
+    thrown = false;
+    try {
+        copier.copyMember(reader, reader.getMembers()[0]);
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    check(thrown, "archive duplicate copied");
+
+    // The directory comes last, so the last "ab" is the second name
+    archive[archive.rfind("ab") + 1] = 'a';
+    thrown = false;
+    try {
+        hfm::ArchiveReader damaged(archive.data(), archive.size());
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    check(thrown, "archive duplicate read");
+}
+
+// A pooled decoder starts without the checksum an earlier user of the
+// thread turned on
+void checkContextPool() {
+    const std::vector<char> data   = hfm::test::makeText(5000, 6);
+    const std::vector<char> stream = huffmanCompress(data, 1 << 16);
+    std::vector<char> output(data.size());
+
+    for (bool enabled : {true, false}) {
+        hfm::HuffmanDecoder& decoder =
+            hfm::ContextPool::getDecoder(stream.data(), stream.size());
+        if (enabled) {
+            decoder.setChecksum(true);
+        }
+        while (decoder.decompress(output.data(), output.size()) >= 0) {
+        }
+        check((decoder.getChecksum() != 0) == enabled,
+              enabled ? "pooled checksum" : "pooled checksum reset");
+    }
+}
+
+// Blocks never exceed the largest size asked for, and sizes smaller than a
+// segment of the splitter are refused
+void checkBlockSizes() {
+    const std::vector<char> data = hfm::test::makeCorpora(100000)[5].data;
+    hfm::BlockCoder coder(data.data(), data.size());
+
+    bool thrown = false;
+    try {
+        coder.setMaxBlockSize(hfm::BlockSplitter::SEGMENT_SIZE - 1);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    check(thrown, "block size below a segment");
+
+    thrown = false;
+    try {
+        hfm::JobPool pool(1, 1);
+        pool.setMaxBlockSize(1);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    check(thrown, "job block size below a segment");
+
+    coder.setMaxBlockSize(hfm::BlockSplitter::SEGMENT_SIZE);
+    const std::vector<std::uint64_t>& blocks = coder.getBlocks();
+    check(std::all_of(blocks.begin(), blocks.end(),
+                      [](std::uint64_t size) {
+                          return size <= hfm::BlockSplitter::SEGMENT_SIZE;
+                      }),
+          "smallest block size");
+}
+
+// Counts above 32 bits, as in inputs over 4 GiB, keep their weight in the
+// codes and survive serialization. The low 32 bits of the largest count
+// are 1, so a truncated count would give it the longest code.
+void checkLargeCounts() {
+    std::uint64_t counts[hfm::Histogram::SYMBOLS] = {};
+    counts['a'] = (5ULL << 32) + 1;
+    counts['b'] = 3ULL << 32;
+    counts['c'] = 1ULL << 32;
+    counts['d'] = 7;
+    const unsigned int lengths[] = {1, 2, 3, 3};
+
+    try {
+        hfm::Code codes[hfm::Histogram::SYMBOLS];
+        hfm::CodeBuilder builder(hfm::Histogram::SYMBOLS);
+        check(builder.build(counts, codes) == 3, "large counts longest");
+
+        hfm::Histogram histogram(counts);
+        check(histogram.getTotal() == (9ULL << 32) + 8, "large counts total");
+        char buff[hfm::Histogram::MAX_SERIALIZED_SIZE];
+        hfm::Histogram loaded =
+            hfm::Histogram::deserialize(buff, histogram.serialize(buff));
+        check(std::equal(counts, counts + hfm::Histogram::SYMBOLS,
+                         loaded.getCounts()),
+              "large counts serialized");
+
+        hfm::Code shared[hfm::Histogram::SYMBOLS];
+        loaded.buildCodes(shared);
+        for (int i = 0; i < 4; i++) {
+            check(codes['a' + i].length == lengths[i] &&
+                      shared['a' + i].length == lengths[i],
+                  std::string("large counts length ") +
+                      static_cast<char>('a' + i));
+        }
+    } catch (const std::exception& e) {
+        check(false, std::string("large counts: ") + e.what());
+    }
+}
+
+// A saved profile loads back the same, and a damaged one is rejected
+void checkProfile() {
+    const std::string path =
+        (std::filesystem::temp_directory_path() / "hfm-test-profile")
+            .string();
+    try {
+        hfm::Profile profile;
+        profile.threads      = 3;
+        profile.segmentSize  = 2 << 20;
+        profile.maxBlockSize = 256 << 10;
+        profile.save(path);
+
+        hfm::Profile loaded = hfm::Profile::load(path);
+        check(loaded.threads == 3 && loaded.segmentSize == (2 << 20) &&
+                  loaded.maxBlockSize == (256 << 10),
+              "profile");
+    } catch (const std::exception& e) {
+        check(false, std::string("profile: ") + e.what());
+    }
+
+    const char* damaged[] = {"threads=0\n", "threads=4x\n",
+                             "max_block_size=2097152\n", "threads\n"};
+    for (const char* contents : damaged) {
+        std::ofstream(path) << contents;
+        bool thrown = false;
+        try {
+            hfm::Profile::load(path);
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        check(thrown, std::string("damaged profile ") + contents);
+    }
+    std::filesystem::remove(path);
+}
+
+// A cut stream must be rejected unless only padding was cut, and must
+// never be read past its end
+void checkTruncated(const std::vector<char>& data, const std::string& name) {
+    std::vector<char> stream = huffmanCompress(data, data.size() + (1 << 16));
+    for (std::uint64_t size = 0; size < stream.size(); size++) {
+        std::vector<char> cut(stream.begin(), stream.begin() + size);
+        bool passed = true;
+        try {
+            passed = huffmanDecompress(cut, 512) == data;
+        } catch (const std::runtime_error&) {
+        }
+        check(passed, "truncated " + name + " at " + std::to_string(size));
+    }
+}
+
+}
+
+int main() {
+    std::cout << "Kernels: " << hfm::Kernels::get().encodeName << ", "
+              << hfm::Kernels::get().refillName << std::endl;
+
+    checkAll({}, "empty");
+    checkAll({'x'}, "single byte");
+    checkAll(std::vector<char>(100000, 'a'), "single symbol");
+
+    std::vector<char> all(256);
+    std::iota(all.begin(), all.end(), 0);
+    checkAll(all, "all symbols");
+
+    // Every byte value, with counts far enough apart for codes of very
+    // different lengths
+    std::vector<char> deep;
+    for (int i = 0; i < 256; i++) {
+        deep.insert(deep.end(), 1 + (i * i * i) % 5000, static_cast<char>(i));
+    }
+    checkAll(deep, "all symbols skewed");
+
+    // Three symbols with codes of 1 and 2 bits, at every size up to a few
+    // words, so the stream ends at every bit position of its last word
+    for (std::uint64_t size = 1; size <= 200; size++) {
+        std::vector<char> odd(size);
+        for (std::uint64_t i = 0; i < size; i++) {
+            odd[i] = "aabac"[i % 5];
+        }
+        checkAll(odd, "odd trailing bits " + std::to_string(size));
+    }
+
+    const std::uint64_t sizes[] = {1, 7, 63, 64, 65, 4095, 100000, 3 << 20};
+    for (std::uint64_t size : sizes) {
+        for (const auto& corpus : hfm::test::makeCorpora(size)) {
+            checkAll(corpus.data,
+                     corpus.name + " " + std::to_string(size));
+        }
+    }
+
+    checkAdaptiveSections();
+    checkAdaptiveTruncated();
+    checkWideLongCodes();
+    checkArchiveDuplicates();
+    checkLargeCounts();
+    checkBlockSizes();
+    checkContextPool();
+    checkHistogramLimit();
+    checkShards(hfm::test::makeCorpora(50000));
+    checkJobs();
+    checkProfile();
+
+    checkTruncated(hfm::test::makeText(3000, 8), "text");
+    checkTruncated(all, "all symbols");
+
+    if (failures != 0) {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+
+    std::cout << "All round trips passed" << std::endl;
+    return 0;
+}
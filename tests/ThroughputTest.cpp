@@ -0,0 +1,241 @@
+// Copyright 2021 Sirbu Dan
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "Corpus.hpp"
+#include <HuffmanCoder.hpp>
+#include <HuffmanDecoder.hpp>
+#include <BlockCoder.hpp>
+#include <BlockDecoder.hpp>
+#include <algorithm>
+#include <ctime>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cstdint>
+
+// Measures single threaded throughput relative to memcpy() on the same
+// data, so results carry over between machines and between runs on a
+// machine whose speed varies, and compares it with the baseline file given
+// as the first argument. A result more than the tolerance (second argument,
+// 0.25 by default) below its baseline fails the test, as does a missing
+// baseline. With HFM_UPDATE_BASELINE set, the results are written as the
+// new baseline instead and nothing is compared.
+
+namespace {
+
+constexpr std::uint64_t CORPUS_SIZE = 8 << 20;
+// Each result is the best of several runs, to keep scheduling noise out
+constexpr int RUNS = 5;
+// Measurements of a result before it counts as slower
+constexpr int ATTEMPTS = 5;
+// Copies of the corpus in one memcpy() measurement, which is short
+constexpr int COPIES = 16;
+// Returned to CTest when the test cannot give a meaningful result
+constexpr int SKIPPED = 77;
+
+double measure(const std::function<void()>& run, std::uint64_t bytes) {
+    // CPU time, so time the machine spends on other work is not counted
+    double best = 0;
+    for (int i = 0; i < RUNS; i++) {
+        std::clock_t start = std::clock();
+        run();
+        double elapsed = static_cast<double>(std::clock() - start) /
+                         CLOCKS_PER_SEC;
+        best = std::max(best, bytes / elapsed / (1 << 20));
+    }
+
+    return best;
+}
+
+// Throughput of run as a fraction of the throughput of copy, both measured
+// now so a change in the speed of the machine cancels out
+double measureRatio(const std::function<void()>& run,
+                    const std::function<void()>& copy) {
+    const double copied = measure(copy, CORPUS_SIZE * COPIES);
+    return measure(run, CORPUS_SIZE) / copied;
+}
+
+std::vector<char> huffmanCompress(const std::vector<char>& data) {
+    hfm::HuffmanCoder coder(data.data(), data.size());
+    std::vector<char> stream(data.size() * 2 + (1 << 16));
+    std::uint64_t size   = 0;
+    std::int64_t written = 0;
+    while ((written = coder.compress(stream.data() + size,
+                                     stream.size() - size)) >= 0) {
+        size += written;
+    }
+
+    if (written == -2) {
+        size += coder.getLastBytes();
+    }
+    stream.resize(size);
+
+    return stream;
+}
+
+void huffmanDecompress(const std::vector<char>& stream,
+                       std::vector<char>& data) {
+    hfm::HuffmanDecoder decoder(stream.data(), stream.size());
+    std::uint64_t size   = 0;
+    std::int64_t written = 0;
+    while ((written = decoder.decompress(data.data() + size,
+                                         data.size() - size)) >= 0) {
+        size += written;
+    }
+}
+
+std::vector<char> blockCompress(const std::vector<char>& data) {
+    hfm::BlockCoder coder(data.data(), data.size());
+    std::vector<char> stream;
+    std::vector<char> buffer(hfm::BlockCoder::MAX_OUTPUT);
+    std::int64_t written = 0;
+    while ((written = coder.compress(buffer.data(), buffer.size())) >= 0) {
+        stream.insert(stream.end(), buffer.begin(), buffer.begin() + written);
+    }
+
+    return stream;
+}
+
+void blockDecompress(const std::vector<char>& stream,
+                     std::vector<char>& data) {
+    hfm::BlockDecoder decoder(stream.data(), stream.size());
+    for (const auto& block : decoder.getBlocks()) {
+        hfm::HuffmanDecoder huffman(nullptr, 0);
+        hfm::BlockDecoder::decodeBlock(stream.data(), block,
+                                       data.data() + block.outputOffset,
+                                       huffman);
+    }
+}
+
+std::map<std::string, double> readBaseline(const char* path) {
+    std::map<std::string, double> baseline;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string name;
+        double value = 0;
+        if (line.empty() || line[0] == '#' || !(fields >> name >> value)) {
+            continue;
+        }
+        baseline[name] = value;
+    }
+
+    return baseline;
+}
+
+void writeBaseline(const char* path,
+                   const std::map<std::string, double>& results) {
+    std::ofstream out(path);
+    out << "# Throughput as a fraction of memcpy(), best of " << RUNS
+        << " runs on " << (CORPUS_SIZE >> 20) << " MiB of data.\n"
+        << "# Regenerate with HFM_UPDATE_BASELINE=1.\n";
+    for (const auto& result : results) {
+        out << result.first << " " << std::fixed << std::setprecision(4)
+            << result.second << "\n";
+    }
+}
+
+}
+
+int main(int argc, char** argv) {
+#ifdef HFM_DEBUG
+    std::cout << "Skipped: throughput is only checked in optimized builds"
+              << std::endl;
+    return SKIPPED;
+#endif
+
+    if (argc < 2) {
+        std::cerr << "Usage: ThroughputTest baseline_file [tolerance]"
+                  << std::endl;
+        return 1;
+    }
+
+    const double tolerance = argc > 2 ? std::atof(argv[2]) : 0.25;
+
+    const std::vector<char> text  = hfm::test::makeText(CORPUS_SIZE, 1);
+    const std::vector<char> mixed = hfm::test::makeCorpora(CORPUS_SIZE)[5].data;
+    const std::vector<char> textStream  = huffmanCompress(text);
+    const std::vector<char> mixedStream = blockCompress(mixed);
+    std::vector<char> output(CORPUS_SIZE);
+
+    const auto copy = [&]() {
+        for (int i = 0; i < COPIES; i++) {
+            std::memcpy(output.data(), text.data(), CORPUS_SIZE);
+        }
+    };
+
+    const std::vector<std::pair<std::string, std::function<void()>>> runs = {
+        {"huffman-encode", [&]() { huffmanCompress(text); }},
+        {"huffman-decode", [&]() { huffmanDecompress(textStream, output); }},
+        {"block-encode", [&]() { blockCompress(mixed); }},
+        {"block-decode", [&]() { blockDecompress(mixedStream, output); }}};
+
+    std::map<std::string, double> baseline;
+    if (std::getenv("HFM_UPDATE_BASELINE") != nullptr) {
+        // The median of several measurements, so one lucky run does not
+        // set a bar that later runs cannot reach
+        for (const auto& run : runs) {
+            std::vector<double> values;
+            for (int i = 0; i < ATTEMPTS; i++) {
+                values.push_back(measureRatio(run.second, copy));
+            }
+            std::sort(values.begin(), values.end());
+            baseline[run.first] = values[values.size() / 2];
+        }
+
+        writeBaseline(argv[1], baseline);
+        std::cout << "Baseline written to " << argv[1] << std::endl;
+        return 0;
+    }
+
+    baseline = readBaseline(argv[1]);
+    for (const auto& run : runs) {
+        if (baseline.count(run.first) == 0) {
+            std::cerr << "No baseline for " << run.first << " in " << argv[1]
+                      << ", record one with HFM_UPDATE_BASELINE=1"
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    int slower = 0;
+    for (const auto& run : runs) {
+        const double expected = baseline[run.first];
+
+        // A real slowdown shows in every attempt, noise rarely does
+        double result = 0;
+        for (int i = 0; i < ATTEMPTS && result < expected * (1 - tolerance);
+             i++) {
+            result = std::max(result, measureRatio(run.second, copy));
+        }
+        bool passed = result >= expected * (1 - tolerance);
+
+        std::cout << std::left << std::setw(16) << run.first << std::right
+                  << std::fixed << std::setprecision(4) << std::setw(9)
+                  << result << " of memcpy (baseline " << expected << ")"
+                  << (passed ? "" : "  SLOWER") << std::endl;
+        slower += passed ? 0 : 1;
+    }
+
+    return slower == 0 ? 0 : 1;
+}